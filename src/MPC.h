@@ -1,27 +1,67 @@
 #ifndef MPC_H
 #define MPC_H
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
+#include "backend_registry.h"
+#include "kinematic_model.h"
+#include "mpc_layout.h"
+#include "solver_backend.h"
 
 using namespace std;
 
-// This value assumes the model presented in the classroom is used.
-//
-// It was obtained by measuring the radius formed by running the vehicle in the
-// simulator around in a circle with a constant steering angle and velocity on a
-// flat terrain.
-//
-// Lf was tuned until the the radius formed by the simulating the model
-// presented in the classroom matched the previous radius.
-//
-// This is the length from front to CoG that has a similar radius.
-const double Lf = 2.67;
+/**
+ * The plan found by a solve over a horizon of N timesteps, with how the solve
+ * went.
+ */
+template <size_t N>
+struct MPCSolution {
+    // The first actuations of the plan, the ones to apply now.
+    double steering;
+    double throttle;
 
+    // The predicted states, starting with the initial state.
+    std::array<double, N> x;
+    std::array<double, N> y;
+    std::array<double, N> psi;
+    std::array<double, N> v;
+    std::array<double, N> cte;
+    std::array<double, N> epsi;
+
+    // The planned actuations, one per timestep but the last.
+    std::array<double, N - 1> delta;
+    std::array<double, N - 1> a;
+
+    SolveStats stats;
+};
+
+/**
+ * Model predictive controller over a horizon of N timesteps.
+ *
+ * The horizon is fixed at compile time so the variable layout is constexpr and
+ * all per-solve storage has a fixed size. Each instance owns its own solver
+ * backend, so several configurations can run side by side.
+ */
+template <size_t N>
 class MPC {
 
 public:
-    MPC();
+    typedef MPCLayout<N> Layout;
+    typedef std::array<double, Layout::n_vars> VarVector;
+
+    /**
+     * @param backend  name of the solver backend, see backend_registry.h
+     * @param dt  timestep duration, in seconds
+     * @param linear_solver  for the Ipopt backends, a linear solver to use
+     *                       instead of MUMPS, which only solves for one
+     *                       controller at a time; see NewSolverBackend
+     */
+    explicit MPC(const string &backend = default_solver_backend, double dt = 0.1,
+                 const char *linear_solver = NULL);
 
     virtual ~MPC();
 
@@ -29,9 +69,49 @@ public:
      * Solves the model given an initial state and polynomial coefficients.
      * @param state 
      * @param coeffs
-     * @return the first (several sp?) actuations.
+     * @param deadline  wall-clock time by which the solve returns, with the
+     *                  best plan found so far if it has not converged
+     * @return the plan, outcome, timing and iterations. Reused by the next
+     *         call, which overwrites it.
+     */
+    const MPCSolution<N> &Solve(const StateVector &state, const CoeffVector &coeffs,
+                                std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * Forgets the previous solves, so the next one is not warm started from
+     * them. For solving unrelated problems one after the other.
+     */
+    void Reset() { backend->Reset(); }
+
+    /**
+     * Makes the following solves stop early, with SOLVE_CANCELLED, once token
+     * is cancelled. Only the Ipopt backends can stop early.
+     * @param token  outlives the controller, or NULL for none
+     */
+    void SetCancelToken(const CancelToken *token) { backend->SetCancelToken(token); }
+
+    /**
+     * Does what it can of the next Solve before its state arrives, see
+     * SolverBackend::PrepareNext.
      */
-    vector<double> Solve(Eigen::VectorXd state, Eigen::VectorXd coeffs);
+    void PrepareNext() { backend->PrepareNext(); }
+
+    /**
+     * @return the result of the last Solve
+     */
+    const MPCSolution<N> &LastSolution() const { return solution; }
+
+private:
+    string backend_name;
+    std::unique_ptr<SolverBackend<N> > backend;
+
+    // Filled in place by every Solve.
+    MPCSolution<N> solution;
 };
 
+extern template class MPC<10>;
+extern template class MPC<15>;
+extern template class MPC<20>;
+extern template class MPC<128>;
+
 #endif /* MPC_H */
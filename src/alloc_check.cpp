@@ -0,0 +1,128 @@
+// Counts the heap allocations of steady-state MPC::Solve calls and fails if
+// any happen outside the solver.
+//
+// An allocation counts as the solver's when it is made by Ipopt or its linear
+// solver, that is when the innermost caller of operator new outside the C++
+// runtime lies in one of their libraries. Those are reported but allowed.
+// Everything else is ours and must not allocate at all: the controller, the
+// backends, and the TNLP callbacks Ipopt makes with the CppAD sweeps they run
+// (CppAD is compiled into this binary).
+//
+// ipopt_multistart is left out: it hands its starts to the compute workers,
+// which is another thread's allocations.
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "MPC.h"
+#include "logger.h"
+
+namespace {
+
+// Only the allocations of the thread running the solves, while it runs them.
+thread_local bool counting = false;
+long solver_allocations = 0;
+long outside_allocations = 0;
+
+// The libraries of Ipopt and of the linear solvers it loads.
+const char *const solver_libraries[] = {"libipopt", "libcoinmumps", "libdmumps", "libcoinhsl",
+                                        "libhsl", "libcoinmetis", "libmetis"};
+// The C++ runtime, which allocates on behalf of its callers.
+const char *const runtime_libraries[] = {"libstdc++", "libc.so", "libgcc_s"};
+
+template <size_t K>
+bool in_libraries(const char *file, const char *const (&libraries)[K]) {
+    for (const char *library : libraries) {
+        if (strstr(file, library) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Frames of this function and of operator new, on top of the stack it sees.
+const int own_frames = 2;
+
+__attribute__((noinline)) bool allocated_by_solver() {
+    void *frames[128];
+    const int depth = backtrace(frames, 128);
+    for (int i = own_frames; i < depth; ++i) {
+        Dl_info info;
+        if (!dladdr(frames[i], &info) || info.dli_fname == NULL
+            || in_libraries(info.dli_fname, runtime_libraries)) {
+            continue;
+        }
+        return in_libraries(info.dli_fname, solver_libraries);
+    }
+    return false;
+}
+
+}  // namespace
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    if (counting) {
+        // backtrace may allocate the first time.
+        counting = false;
+        if (allocated_by_solver()) {
+            ++solver_allocations;
+        } else {
+            ++outside_allocations;
+        }
+        counting = true;
+    }
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+// Ticks solved before counting, so the warm start is in place.
+static const int warm_up_ticks = 3;
+static const int counted_ticks = 10;
+
+int main() {
+    // Only warnings, so the counted ticks log nothing in the usual case.
+    SetLogLevel(LOG_WARN);
+    void *frame;
+    backtrace(&frame, 1);
+
+    const char *backends[] = {"ipopt_cppad", "ipopt_analytic", "ltv_qp", "ilqr", "ilqr_rti"};
+    const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::time_point::max();
+    bool ok = true;
+    for (const char *backend : backends) {
+        MPC<10> mpc(backend);
+        StateVector state;
+        state << 0, 0, 0, 10, 1.0, -0.2;
+        CoeffVector coeffs;
+        coeffs << 1.0, 0.2, 0.01, -0.001;
+
+        solver_allocations = 0;
+        outside_allocations = 0;
+        for (int tick = 0; tick < warm_up_ticks + counted_ticks; ++tick) {
+            // The road drifts a little from tick to tick, as it does driving.
+            coeffs[0] = 1.0 - 0.01 * tick;
+            counting = tick >= warm_up_ticks;
+            mpc.Solve(state, coeffs, deadline);
+            counting = false;
+        }
+
+        printf("%-16s %8.1f allocations per tick in the solver, %ld outside\n", backend,
+               (double) solver_allocations / counted_ticks, outside_allocations);
+        if (outside_allocations != 0) {
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#ifndef AUGMENTED_MODEL_H
+#define AUGMENTED_MODEL_H
+
+#include <array>
+#include "Eigen-3.3/Eigen/Core"
+#include "kinematic_model.h"
+#include "mpc_layout.h"
+
+/**
+ * The kinematic model in the stage-wise form used by the LTV and iLQR backends.
+ *
+ * The actuation smoothing terms of the cost couple sequential actuations, so
+ * the state is augmented with the previous actuation: x, y, psi, v, cte, epsi,
+ * then the previous delta and a. The smoothing terms then become ordinary
+ * state/actuation cross terms of a single stage.
+ */
+struct AugmentedModel {
+    static constexpr int nz = n_state + n_actuators;
+    static constexpr int nu = n_actuators;
+
+    typedef Eigen::Matrix<double, nz, 1> ZVector;
+    typedef Eigen::Matrix<double, nu, 1> UVector;
+    typedef Eigen::Matrix<double, nz, nz> ZZMatrix;
+    typedef Eigen::Matrix<double, nz, nu> ZUMatrix;
+    typedef Eigen::Matrix<double, nu, nz> UZMatrix;
+    typedef Eigen::Matrix<double, nu, nu> UUMatrix;
+
+    /**
+     * Advances the augmented state by one timestep with kinematic_step.
+     */
+    static void Step(ZVector &next, const ZVector &z, const UVector &u,
+                     const double *coeffs, double dt) {
+        kinematic_step(next.data(), z.data(), u(0), u(1), coeffs, dt);
+        next.tail<nu>() = u;
+    }
+
+    /**
+     * Linearizes Step around (z, u), filling in the non-constant blocks of A
+     * and B. The rows for the carried actuation are fixed: B holds the identity
+     * there and A zeros, so both only need to be initialized once.
+     */
+    static void Linearize(ZZMatrix &A, ZUMatrix &B, const ZVector &z, const UVector &u,
+                          const double *coeffs, double dt) {
+        double jac[n_state * 8];
+        kinematic_step_jacobian(jac, z.data(), u(0), u(1), coeffs, dt);
+        Eigen::Map<Eigen::Matrix<double, n_state, 8, Eigen::RowMajor> > J(jac);
+        A.topLeftCorner<n_state, n_state>() = J.leftCols<n_state>();
+        B.topRows<n_state>() = J.rightCols<nu>();
+    }
+
+    /**
+     * Initializes A and B to the fixed structure Linearize relies on.
+     */
+    static void InitLinearization(ZZMatrix &A, ZUMatrix &B) {
+        A.setZero();
+        B.setZero();
+        B.bottomRows<nu>().setIdentity();
+    }
+
+    /**
+     * Actuator limits: |delta| <= max_delta, |a| <= max_accel.
+     */
+    static UVector MaxActuation() {
+        UVector u_max;
+        u_max << max_delta, max_accel;
+        return u_max;
+    }
+};
+
+/**
+ * The FG_eval objective split into stages over the augmented state:
+ * stage t costs 1/2 z'Qz + q_ref'z + 1/2 u'Ru + u'Sz, up to a constant.
+ *
+ * The cost is a sum of squares, so its Hessian is constant. Stage t holds the
+ * state cost at t and, from t = 1 on, the smoothing term between the previous
+ * actuation (carried in the state) and the current one. The last stage has
+ * no actuation.
+ */
+template <size_t N>
+struct AugmentedCost {
+    typedef AugmentedModel M;
+
+    std::array<M::ZZMatrix, N> Q;
+    std::array<M::UUMatrix, N - 1> R;
+    std::array<M::UZMatrix, N - 1> S;
+    M::ZVector q_ref;
+
+    AugmentedCost() {
+        M::ZZMatrix state_hessian = M::ZZMatrix::Zero();
+        state_hessian(3, 3) = 2 * v_weight;
+        state_hessian(4, 4) = 2 * cte_weight;
+        state_hessian(5, 5) = 2 * epsi_weight;
+
+        for (size_t t = 0; t < N; ++t) {
+            Q[t] = state_hessian;
+        }
+        for (size_t t = 0; t < N - 1; ++t) {
+            R[t] = M::UUMatrix::Zero();
+            R[t](0, 0) = 2 * delta_weight;
+            R[t](1, 1) = 2 * accel_weight;
+            S[t] = M::UZMatrix::Zero();
+            if (t >= 1) {
+                Q[t](6, 6) = 2 * delta_change_weight;
+                Q[t](7, 7) = 2 * accel_change_weight;
+                R[t](0, 0) += 2 * delta_change_weight;
+                R[t](1, 1) += 2 * accel_change_weight;
+                S[t](0, 6) = -2 * delta_change_weight;
+                S[t](1, 7) = -2 * accel_change_weight;
+            }
+        }
+
+        q_ref = M::ZVector::Zero();
+        q_ref(3) = -2 * v_weight * ref_v;
+        q_ref(4) = -2 * cte_weight * ref_cte;
+        q_ref(5) = -2 * epsi_weight * ref_epsi;
+    }
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Writes an augmented trajectory and its actuations in the MPCLayout<N>
+ * variable layout used by Ipopt, and returns its FG_eval cost.
+ */
+template <size_t N>
+double augmented_to_vars(std::array<double, MPCLayout<N>::n_vars> &vars,
+                         const std::array<AugmentedModel::ZVector, N> &z,
+                         const std::array<AugmentedModel::UVector, N - 1> &u) {
+    typedef MPCLayout<N> Layout;
+    for (size_t t = 0; t < N; ++t) {
+        for (size_t i = 0; i < n_state; ++i) {
+            vars[Layout::x_start + i * N + t] = z[t](i);
+        }
+    }
+    for (size_t t = 0; t < N - 1; ++t) {
+        vars[Layout::delta_start + t] = u[t](0);
+        vars[Layout::accel_start + t] = u[t](1);
+    }
+    return mpc_cost<N>(vars.data());
+}
+
+#endif /* AUGMENTED_MODEL_H */
@@ -0,0 +1,132 @@
+#include "backend_registry.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "cppad_threads.h"
+#include "fg_eval.h"
+#include "ilqr.h"
+#include "ipopt_backend.h"
+#include "kinematic_nlp.h"
+#include "logger.h"
+#include "ltv_mpc.h"
+#include "mpc_nlp.h"
+#include "multistart_backend.h"
+
+template <size_t N>
+struct BackendFactory {
+    const char *name;
+    const char *description;
+    SolverBackend<N> *(*create)(double dt, const char *linear_solver);
+};
+
+// An Ipopt backend for nlp, on linear_solver if Ipopt can load it.
+template <size_t N>
+static SolverBackend<N> *new_ipopt(const Ipopt::SmartPtr<MPCProblem<N> > &nlp,
+                                   const char *linear_solver) {
+    std::unique_ptr<IpoptBackend<N> > backend(new IpoptBackend<N>(nlp, linear_solver));
+    if (linear_solver != NULL && !backend->CheckLinearSolver()) {
+        Log(LOG_WARN, "WARN: Ipopt cannot load %s, using MUMPS, one solve at a time!",
+            linear_solver);
+        backend.reset(new IpoptBackend<N>(nlp));
+    }
+    return backend.release();
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ipopt_analytic(double dt, const char *linear_solver) {
+    return new_ipopt<N>(new KinematicNLP<N>(dt), linear_solver);
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ipopt_cppad(double dt, const char *linear_solver) {
+    // The tape belongs to this thread, which has to have a CppAD number.
+    if (!ClaimCppADThread()) {
+        Log(LOG_WARN, "WARN: Too many threads use CppAD, using analytic derivatives!");
+        return new_ipopt_analytic<N>(dt, linear_solver);
+    }
+    // Record the tape once; every Solve reuses it.
+    FG_eval<N> fg_eval(dt);
+    return new_ipopt<N>(new MPC_NLP<N>(fg_eval), linear_solver);
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ipopt_multistart(double dt, const char *) {
+    std::unique_ptr<MultiStartBackend<N> > backend(new MultiStartBackend<N>(dt));
+    if (!backend->CheckLinearSolver()) {
+        Log(LOG_WARN, "WARN: Ipopt cannot load MA27, which ipopt_multistart needs!");
+        return NULL;
+    }
+    return backend.release();
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ltv_qp(double dt, const char *) {
+    return new LTVMPC<N>(dt);
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ilqr(double dt, const char *) {
+    return new ILQR<N>(dt);
+}
+
+template <size_t N>
+static SolverBackend<N> *new_ilqr_rti(double dt, const char *) {
+    return new ILQR<N>(dt, true);
+}
+
+// Every backend, the default first. Add new ones here.
+template <size_t N>
+static const std::vector<BackendFactory<N> > &factories() {
+    static const std::vector<BackendFactory<N> > registry = {
+        {"ipopt_cppad", "Ipopt, with sparse sweeps over a CppAD tape of FG_eval",
+         new_ipopt_cppad<N>},
+        {"ipopt_analytic", "Ipopt, with hand-written derivatives of the kinematic model",
+         new_ipopt_analytic<N>},
+        {"ipopt_multistart", "Ipopt from three starts in parallel, the best feasible plan wins (needs MA27)",
+         new_ipopt_multistart<N>},
+        {"ltv_qp", "One QP linearized around the previous plan, Riccati interior point",
+         new_ltv_qp<N>},
+        {"ilqr", "Iterative LQR with the actuator limits in the backward pass",
+         new_ilqr<N>},
+        {"ilqr_rti", "One real-time iLQR iteration per tick, for bounded latency",
+         new_ilqr_rti<N>},
+    };
+    return registry;
+}
+
+template <size_t N>
+SolverBackend<N> *NewSolverBackend(const std::string &name, double dt, const char *linear_solver) {
+    for (const BackendFactory<N> &factory : factories<N>()) {
+        if (name == factory.name) {
+            return factory.create(dt, linear_solver);
+        }
+    }
+    return NULL;
+}
+
+// The same backends are registered for every horizon, so any will do for the
+// names.
+bool IsSolverBackend(const std::string &name) {
+    for (const BackendFactory<10> &factory : factories<10>()) {
+        if (name == factory.name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PrintSolverBackends(std::ostream &out) {
+    for (const BackendFactory<10> &factory : factories<10>()) {
+        out << "  " << factory.name << ": " << factory.description << std::endl;
+    }
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template SolverBackend<10> *NewSolverBackend<10>(const std::string &name, double dt,
+                                                 const char *linear_solver);
+template SolverBackend<15> *NewSolverBackend<15>(const std::string &name, double dt,
+                                                 const char *linear_solver);
+template SolverBackend<20> *NewSolverBackend<20>(const std::string &name, double dt,
+                                                 const char *linear_solver);
+template SolverBackend<128> *NewSolverBackend<128>(const std::string &name, double dt,
+                                                   const char *linear_solver);
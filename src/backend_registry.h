@@ -0,0 +1,49 @@
+#ifndef BACKEND_REGISTRY_H
+#define BACKEND_REGISTRY_H
+
+#include <ostream>
+#include <string>
+#include "solver_backend.h"
+
+// The backend MPC uses unless told otherwise.
+const char *const default_solver_backend = "ipopt_cppad";
+
+// A linear solver for Ipopt that is re-entrant, unlike its default MUMPS, so
+// that Ipopt solves on different threads can run side by side: MA27 from HSL.
+const char *const reentrant_linear_solver = "ma27";
+
+/**
+ * Creates a solver backend by name, so the backend can be picked at run time
+ * (see the --backend flag of main).
+ * @param name  one of the names listed by PrintSolverBackends
+ * @param dt  timestep duration, in seconds
+ * @param linear_solver  for the Ipopt backends, the linear solver to use
+ *                       instead of MUMPS if Ipopt can load it, such as
+ *                       reentrant_linear_solver; NULL for MUMPS
+ * @return the new backend, or NULL if no backend has that name or it cannot
+ *         run with this Ipopt
+ */
+template <size_t N>
+SolverBackend<N> *NewSolverBackend(const std::string &name, double dt,
+                                   const char *linear_solver = NULL);
+
+/**
+ * @return whether a backend is registered under name
+ */
+bool IsSolverBackend(const std::string &name);
+
+/**
+ * Lists the registered backends, one name and description per line.
+ */
+void PrintSolverBackends(std::ostream &out);
+
+extern template SolverBackend<10> *NewSolverBackend<10>(const std::string &name, double dt,
+                                                        const char *linear_solver);
+extern template SolverBackend<15> *NewSolverBackend<15>(const std::string &name, double dt,
+                                                        const char *linear_solver);
+extern template SolverBackend<20> *NewSolverBackend<20>(const std::string &name, double dt,
+                                                        const char *linear_solver);
+extern template SolverBackend<128> *NewSolverBackend<128>(const std::string &name, double dt,
+                                                          const char *linear_solver);
+
+#endif /* BACKEND_REGISTRY_H */
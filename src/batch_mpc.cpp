@@ -0,0 +1,54 @@
+#include "batch_mpc.h"
+#include <algorithm>
+#include "countdown.h"
+#include "thread_pools.h"
+
+// Problems per pool task, and tasks per thread: enough tasks to even out the
+// slow solves by stealing, few enough to keep the scheduling cheap.
+static const size_t min_problems_per_task = 4;
+static const size_t tasks_per_thread = 8;
+
+template <size_t N>
+BatchMPC<N>::BatchMPC(const std::string &backend, int threads, double dt)
+        : controllers(std::max(threads, 1)), workers(std::max(threads, 1)) {
+    OnEveryThread(workers, [this, &backend, dt](int thread) {
+        controllers[thread].reset(new MPC<N>(backend, dt, reentrant_linear_solver));
+    });
+}
+
+template <size_t N>
+BatchMPC<N>::~BatchMPC() {
+    OnEveryThread(workers, [this](int thread) { controllers[thread].reset(); });
+}
+
+template <size_t N>
+void BatchMPC<N>::Solve(const StateVector *states, const CoeffVector *coeffs, size_t count,
+                        MPCSolution<N> *solutions, std::chrono::steady_clock::duration budget) {
+    const size_t per_task = std::max(min_problems_per_task,
+                                     count / (tasks_per_thread * workers.NumThreads()) + 1);
+    const size_t n_tasks = (count + per_task - 1) / per_task;
+    CountDown running(n_tasks);
+    for (size_t begin = 0; begin < count; begin += per_task) {
+        const size_t end = std::min(begin + per_task, count);
+        workers.Schedule([=, &running] {
+            MPC<N> &mpc = *controllers[workers.CurrentThreadId()];
+            for (size_t i = begin; i < end; ++i) {
+                std::chrono::steady_clock::time_point deadline =
+                        std::chrono::steady_clock::time_point::max();
+                if (budget != std::chrono::steady_clock::duration::max()) {
+                    deadline = std::chrono::steady_clock::now() + budget;
+                }
+                mpc.Reset();
+                solutions[i] = mpc.Solve(states[i], coeffs[i], deadline);
+            }
+            running.Done();
+        });
+    }
+    running.Wait();
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class BatchMPC<10>;
+template class BatchMPC<15>;
+template class BatchMPC<20>;
+template class BatchMPC<128>;
@@ -0,0 +1,81 @@
+#ifndef BATCH_MPC_H
+#define BATCH_MPC_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "unsupported/Eigen/CXX11/ThreadPool"
+#include "MPC.h"
+#include "cppad_threads.h"
+#include "polynomial.h"
+
+/**
+ * Solves many unrelated MPC problems at once, for offline evaluation.
+ *
+ * The problems are spread over a pool of threads, each with its own
+ * controller (backend, tape and solver workspace) set up once and reused for
+ * every problem it picks up. Each problem is solved cold, so the solutions
+ * do not depend on which thread solved what, or in which order. The Ipopt
+ * backends solve on MA27, which is re-entrant; without it, they warn and take
+ * turns on MUMPS.
+ *
+ * Each controller is built and destroyed on its own thread, so a CppAD tape
+ * never leaves the thread that recorded it. Construct and destroy the batch
+ * on the main thread, see CppADParallelSection.
+ */
+template <size_t N>
+class BatchMPC {
+public:
+    /**
+     * @param backend  name of the solver backend, see backend_registry.h
+     * @param threads  number of solver threads
+     * @param dt  timestep duration, in seconds
+     */
+    BatchMPC(const std::string &backend, int threads, double dt = 0.1);
+
+    ~BatchMPC();
+
+    /**
+     * Solves problem i from states[i] along coeffs[i] into solutions[i], for
+     * i < count, and returns when all of them are solved.
+     * @param budget  wall-clock time each problem may take, unbounded by
+     *                default
+     */
+    void Solve(const StateVector *states, const CoeffVector *coeffs, size_t count,
+               MPCSolution<N> *solutions,
+               std::chrono::steady_clock::duration budget =
+                       std::chrono::steady_clock::duration::max());
+
+    /**
+     * Fits the polynomial of each problem to its waypoints, several problems
+     * at a time (see polyfit_batch), then solves them as above.
+     * @param ptsx, ptsy  count sets of M waypoints, in each car's coordinates
+     */
+    template <int M>
+    void Solve(const StateVector *states, const Eigen::Matrix<double, M, 1> *ptsx,
+               const Eigen::Matrix<double, M, 1> *ptsy, size_t count,
+               MPCSolution<N> *solutions,
+               std::chrono::steady_clock::duration budget =
+                       std::chrono::steady_clock::duration::max()) {
+        fitted.resize(count);
+        polyfit_batch<M>(ptsx, ptsy, fitted.data(), count);
+        Solve(states, fitted.data(), count, solutions, budget);
+    }
+
+private:
+    // Open for as long as the workers run.
+    CppADParallelSection cppad_section;
+    // One per pool thread, indexed by its thread id.
+    std::vector<std::unique_ptr<MPC<N> > > controllers;
+    Eigen::NonBlockingThreadPool workers;
+    // The polynomials of the last Solve from waypoints.
+    std::vector<CoeffVector, Eigen::aligned_allocator<CoeffVector> > fitted;
+};
+
+extern template class BatchMPC<10>;
+extern template class BatchMPC<15>;
+extern template class BatchMPC<20>;
+extern template class BatchMPC<128>;
+
+#endif /* BATCH_MPC_H */
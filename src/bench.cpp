@@ -0,0 +1,494 @@
+// Microbenchmarks of the hot paths, each against the code it replaced, with a
+// check that both give the same results.
+//
+// Usage: bench [<section>...], every section by default.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Eigen-3.3/Eigen/QR"
+#include "MPC.h"
+#include "fg_eval.h"
+#include "ipopt_backend.h"
+#include "json.hpp"
+#include "kinematic_nlp.h"
+#include "logger.h"
+#include "mpc_nlp.h"
+#include "polynomial.h"
+#include "telemetry.h"
+#include "thread_pools.h"
+
+using Ipopt::Index;
+using Ipopt::Number;
+using json = nlohmann::json;
+
+// Repetitions of each timed call.
+static const int repetitions = 20000;
+// Problems solved to compare whole solves.
+static const int solve_problems = 50;
+
+typedef std::chrono::steady_clock Clock;
+
+static double microseconds(Clock::time_point start, int calls) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / calls;
+}
+
+// The initial state and polynomial of problem k: a car at a speed of 5 to 25,
+// off a gently curving road.
+static void sample_problem(int k, StateVector &state, CoeffVector &coeffs) {
+    const double phase = 0.7 * k;
+    state << 0, 0, 0, 15 + 10 * sin(phase), 1.5 * sin(1.3 * phase), 0.2 * cos(phase);
+    coeffs << state[4], tan(-state[5]), 0.01 * cos(0.5 * phase), -0.0005 * sin(phase);
+}
+
+// The parameters of an NLP for the given initial state and polynomial.
+template <size_t N>
+static typename MPCProblem<N>::ParamVector problem_params(const StateVector &state,
+                                                          const CoeffVector &coeffs) {
+    typename MPCProblem<N>::ParamVector params;
+    for (size_t i = 0; i < n_state; ++i) {
+        params[i] = state[i];
+    }
+    for (size_t i = 0; i < n_coeffs; ++i) {
+        params[n_state + i] = coeffs[i];
+    }
+    return params;
+}
+
+/**
+ * One Ipopt iteration's worth of derivative work: the objective, the
+ * constraints and their first and second derivatives at a new x.
+ */
+class DerivativeCalls {
+public:
+    explicit DerivativeCalls(Ipopt::TNLP &nlp) : nlp(nlp) {
+        Ipopt::TNLP::IndexStyleEnum index_style;
+        nlp.get_nlp_info(n, m, nnz_jac, nnz_hes, index_style);
+        grad.resize(n);
+        g.resize(m);
+        lambda.resize(m);
+        jac.resize(nnz_jac);
+        hes.resize(nnz_hes);
+        for (Index i = 0; i < m; ++i) {
+            lambda[i] = cos(i);
+        }
+        jac_row.resize(nnz_jac);
+        jac_col.resize(nnz_jac);
+        hes_row.resize(nnz_hes);
+        hes_col.resize(nnz_hes);
+        nlp.eval_jac_g(n, NULL, false, m, nnz_jac, jac_row.data(), jac_col.data(), NULL);
+        nlp.eval_h(n, NULL, false, 1., m, NULL, false, nnz_hes, hes_row.data(), hes_col.data(),
+                   NULL);
+    }
+
+    void Evaluate(const Number *x) {
+        nlp.eval_f(n, x, true, f);
+        nlp.eval_grad_f(n, x, false, grad.data());
+        nlp.eval_g(n, x, false, m, g.data());
+        nlp.eval_jac_g(n, x, false, m, nnz_jac, NULL, NULL, jac.data());
+        nlp.eval_h(n, x, false, 1., m, lambda.data(), true, nnz_hes, NULL, NULL, hes.data());
+    }
+
+    Ipopt::TNLP &nlp;
+    Index n, m, nnz_jac, nnz_hes;
+    Number f;
+    std::vector<Number> grad, g, lambda, jac, hes;
+    std::vector<Index> jac_row, jac_col, hes_row, hes_col;
+};
+
+// The largest difference between two sparse matrices, each given as
+// (row, col, value) entries in its own order. Entries one of them leaves out
+// are 0 there, and Ipopt adds up repeated entries.
+static double sparse_difference(const std::vector<Index> &row_a, const std::vector<Index> &col_a,
+                                const std::vector<Number> &value_a,
+                                const std::vector<Index> &row_b, const std::vector<Index> &col_b,
+                                const std::vector<Number> &value_b) {
+    std::map<std::pair<Index, Index>, double> differences;
+    for (size_t k = 0; k < value_a.size(); ++k) {
+        differences[std::make_pair(row_a[k], col_a[k])] += value_a[k];
+    }
+    for (size_t k = 0; k < value_b.size(); ++k) {
+        differences[std::make_pair(row_b[k], col_b[k])] -= value_b[k];
+    }
+    double difference = 0.;
+    for (const auto &entry : differences) {
+        difference = std::max(difference, fabs(entry.second));
+    }
+    return difference;
+}
+
+// The CppAD tape against the analytic derivatives (ipopt_cppad against
+// ipopt_analytic), per evaluation and per solve.
+static void bench_derivatives() {
+    typedef MPCLayout<10> Layout;
+    const double dt = 0.1;
+    FG_eval<10> fg_eval(dt);
+    MPC_NLP<10> taped(fg_eval);
+    KinematicNLP<10> analytic(dt);
+
+    StateVector state;
+    CoeffVector coeffs;
+    sample_problem(0, state, coeffs);
+    const MPCProblem<10>::ParamVector params = problem_params<10>(state, coeffs);
+    taped.SetParameters(params);
+    analytic.SetParameters(params);
+
+    std::vector<Number> x(Layout::n_vars);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = 0.1 * sin(i);
+    }
+    DerivativeCalls taped_calls(taped);
+    DerivativeCalls analytic_calls(analytic);
+    taped_calls.Evaluate(x.data());
+    analytic_calls.Evaluate(x.data());
+    double difference = fabs(taped_calls.f - analytic_calls.f);
+    for (Index i = 0; i < taped_calls.n; ++i) {
+        difference = std::max(difference, fabs(taped_calls.grad[i] - analytic_calls.grad[i]));
+    }
+    for (Index i = 0; i < taped_calls.m; ++i) {
+        difference = std::max(difference, fabs(taped_calls.g[i] - analytic_calls.g[i]));
+    }
+    // The derivatives are laid out differently, so entries are matched up by
+    // row and column.
+    difference = std::max(difference, sparse_difference(
+            taped_calls.jac_row, taped_calls.jac_col, taped_calls.jac,
+            analytic_calls.jac_row, analytic_calls.jac_col, analytic_calls.jac));
+    difference = std::max(difference, sparse_difference(
+            taped_calls.hes_row, taped_calls.hes_col, taped_calls.hes,
+            analytic_calls.hes_row, analytic_calls.hes_col, analytic_calls.hes));
+    printf("derivatives: largest difference %g\n", difference);
+
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        x[r % x.size()] += 1e-9;
+        taped_calls.Evaluate(x.data());
+    }
+    const double taped_time = microseconds(start, repetitions);
+    start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        x[r % x.size()] += 1e-9;
+        analytic_calls.Evaluate(x.data());
+    }
+    const double analytic_time = microseconds(start, repetitions);
+    printf("derivatives: %.2f us per iteration on the tape, %.2f us analytic\n",
+           taped_time, analytic_time);
+
+    const char *backends[] = {"ipopt_cppad", "ipopt_analytic"};
+    for (const char *backend : backends) {
+        MPC<10> mpc(backend, dt);
+        double solve_time = 0.;
+        int iterations = 0;
+        for (int k = 0; k < solve_problems; ++k) {
+            sample_problem(k, state, coeffs);
+            mpc.Reset();
+            const SolveStats &stats = mpc.Solve(state, coeffs, Clock::time_point::max()).stats;
+            solve_time += stats.solve_time;
+            iterations += stats.iterations;
+        }
+        printf("derivatives: %s solves in %.0f us, %.1f iterations, %.1f us per iteration\n",
+               backend, solve_time * 1e6 / solve_problems, (double) iterations / solve_problems,
+               solve_time * 1e6 / std::max(iterations, 1));
+    }
+}
+
+// Waypoint sets fitted by each timed pass.
+static const int waypoint_sets = 4003;
+
+typedef Eigen::Matrix<double, NUM_WAYPOINTS, 1> WaypointVector;
+
+// The fit polyfit<M> replaced: a householderQr solve on a dynamic
+// Vandermonde matrix.
+static Eigen::VectorXd dynamic_polyfit(const Eigen::VectorXd &xvals,
+                                       const Eigen::VectorXd &yvals, int order) {
+    Eigen::MatrixXd A(xvals.size(), order + 1);
+    for (int i = 0; i < xvals.size(); i++) {
+        A(i, 0) = 1.0;
+    }
+    for (int j = 0; j < xvals.size(); j++) {
+        for (int i = 0; i < order; i++) {
+            A(j, i + 1) = A(j, i) * xvals(j);
+        }
+    }
+    return A.householderQr().solve(yvals);
+}
+
+// The fixed-size and batch cubic fits against the dynamic QR, on waypoints
+// spaced like the simulator's.
+static void bench_polyfit() {
+    std::vector<WaypointVector, Eigen::aligned_allocator<WaypointVector> > xs(waypoint_sets);
+    std::vector<WaypointVector, Eigen::aligned_allocator<WaypointVector> > ys(waypoint_sets);
+    std::vector<CoeffVector, Eigen::aligned_allocator<CoeffVector> > batch(waypoint_sets);
+    for (int k = 0; k < waypoint_sets; ++k) {
+        for (int i = 0; i < NUM_WAYPOINTS; ++i) {
+            xs[k][i] = -5 + 15 * i + 10 * fabs(sin(k + 3.1 * i));
+            ys[k][i] = 10 * sin(0.37 * k + 1.7 * i);
+        }
+    }
+
+    polyfit_batch<NUM_WAYPOINTS>(xs.data(), ys.data(), batch.data(), waypoint_sets);
+    double difference = 0.;
+    for (int k = 0; k < waypoint_sets; ++k) {
+        const Eigen::VectorXd reference = dynamic_polyfit(xs[k], ys[k], 3);
+        const double norm = reference.norm();
+        difference = std::max(difference, (polyfit<NUM_WAYPOINTS>(xs[k], ys[k]) - reference).norm() / norm);
+        difference = std::max(difference, (batch[k] - reference).norm() / norm);
+    }
+    printf("polyfit: largest relative difference %g\n", difference);
+
+    const int passes = std::max(repetitions / waypoint_sets, 1);
+    const int fits = passes * waypoint_sets;
+    double sum = 0.;
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < passes; ++r) {
+        for (int k = 0; k < waypoint_sets; ++k) {
+            sum += dynamic_polyfit(xs[k], ys[k], 3)[3];
+        }
+    }
+    const double dynamic_time = microseconds(start, fits);
+    start = Clock::now();
+    for (int r = 0; r < passes; ++r) {
+        for (int k = 0; k < waypoint_sets; ++k) {
+            sum += polyfit<NUM_WAYPOINTS>(xs[k], ys[k])[3];
+        }
+    }
+    const double fixed_time = microseconds(start, fits);
+    start = Clock::now();
+    for (int r = 0; r < passes; ++r) {
+        polyfit_batch<NUM_WAYPOINTS>(xs.data(), ys.data(), batch.data(), waypoint_sets);
+        sum += batch[r][3];
+    }
+    const double batch_time = microseconds(start, fits);
+    printf("polyfit: %.3f us per fit with the dynamic QR, %.3f us fixed size, %.3f us batched"
+           " (checksum %g)\n", dynamic_time, fixed_time, batch_time, sum);
+}
+
+// Telemetry frames recorded from the simulator, standing still and driving.
+static const char *const recorded_frames[] = {
+    "42[\"telemetry\",{\"ptsx\":[-32.16173,-43.49173,-61.09,-78.29172,-93.05002,-107.7717],"
+    "\"ptsy\":[113.361,105.941,92.88499,78.73102,65.34102,50.57938],\"psi_unity\":4.12033,"
+    "\"psi\":3.733651,\"x\":-40.62,\"y\":108.73,\"steering_angle\":0,\"throttle\":0,"
+    "\"speed\":0}]",
+    "42[\"telemetry\",{\"ptsx\":[-6.9,-1.4,3.6,10.2,18.8,30.9],"
+    "\"ptsy\":[-83.2,-89.4,-95.5,-103.3,-111.6,-120.5],\"psi_unity\":2.381233,"
+    "\"psi\":5.043547,\"x\":-21.37567,\"y\":-62.47437,\"steering_angle\":-0.02617994,"
+    "\"throttle\":1,\"speed\":35.53591}]",
+};
+
+// The payload search ParseMessage replaced.
+static std::string has_data(const std::string &s) {
+    const size_t found_null = s.find("null");
+    const size_t b1 = s.find_first_of("[");
+    const size_t b2 = s.rfind("}]");
+    if (found_null != std::string::npos) {
+        return "";
+    } else if (b1 != std::string::npos && b2 != std::string::npos) {
+        return s.substr(b1, b2 - b1 + 2);
+    }
+    return "";
+}
+
+// The old message path: copy the frame, find the payload, parse it into a
+// json DOM and read the fields out of it.
+static bool json_telemetry(const char *data, size_t length, Telemetry &telemetry) {
+    const std::string frame = std::string(data).substr(0, length);
+    const std::string payload = has_data(frame);
+    if (payload.empty()) {
+        return false;
+    }
+    const json j = json::parse(payload);
+    if (j[0].get<std::string>() != "telemetry") {
+        return false;
+    }
+    const json &fields = j[1];
+    const std::vector<double> ptsx = fields["ptsx"];
+    const std::vector<double> ptsy = fields["ptsy"];
+    std::copy(ptsx.begin(), ptsx.end(), telemetry.ptsx.begin());
+    std::copy(ptsy.begin(), ptsy.end(), telemetry.ptsy.begin());
+    telemetry.x = fields["x"];
+    telemetry.y = fields["y"];
+    telemetry.psi = fields["psi"];
+    telemetry.psi_unity = fields["psi_unity"];
+    telemetry.speed = fields["speed"];
+    telemetry.steering_angle = fields["steering_angle"];
+    telemetry.throttle = fields["throttle"];
+    return true;
+}
+
+static bool parse_telemetry(const char *data, size_t length, Telemetry &telemetry) {
+    const char *event;
+    size_t event_length;
+    return ParseMessage(data, length, telemetry, event, event_length) == MESSAGE_TELEMETRY;
+}
+
+// ParseMessage against the json path, on the recorded frames.
+static void bench_telemetry() {
+    const size_t n_frames = sizeof(recorded_frames) / sizeof(recorded_frames[0]);
+    double difference = 0.;
+    for (const char *frame : recorded_frames) {
+        Telemetry old_fields, new_fields;
+        if (!json_telemetry(frame, strlen(frame), old_fields)
+            || !parse_telemetry(frame, strlen(frame), new_fields)) {
+            printf("telemetry: a recorded frame did not parse!\n");
+            return;
+        }
+        for (int i = 0; i < NUM_WAYPOINTS; ++i) {
+            difference = std::max(difference, fabs(old_fields.ptsx[i] - new_fields.ptsx[i]));
+            difference = std::max(difference, fabs(old_fields.ptsy[i] - new_fields.ptsy[i]));
+        }
+        const double old_scalars[] = {old_fields.x, old_fields.y, old_fields.psi,
+                                      old_fields.psi_unity, old_fields.speed,
+                                      old_fields.steering_angle, old_fields.throttle};
+        const double new_scalars[] = {new_fields.x, new_fields.y, new_fields.psi,
+                                      new_fields.psi_unity, new_fields.speed,
+                                      new_fields.steering_angle, new_fields.throttle};
+        for (size_t i = 0; i < sizeof(old_scalars) / sizeof(old_scalars[0]); ++i) {
+            difference = std::max(difference, fabs(old_scalars[i] - new_scalars[i]));
+        }
+    }
+    printf("telemetry: largest difference %g\n", difference);
+
+    double sum = 0.;
+    Telemetry telemetry;
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        const char *frame = recorded_frames[r % n_frames];
+        json_telemetry(frame, strlen(frame), telemetry);
+        sum += telemetry.ptsx[3] + telemetry.speed;
+    }
+    const double json_time = microseconds(start, repetitions);
+    start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        const char *frame = recorded_frames[r % n_frames];
+        parse_telemetry(frame, strlen(frame), telemetry);
+        sum += telemetry.ptsx[3] + telemetry.speed;
+    }
+    const double parse_time = microseconds(start, repetitions);
+    printf("telemetry: %.2f us per frame through json, %.2f us with ParseMessage"
+           " (checksum %g)\n", json_time, parse_time, sum);
+}
+
+// The horizon KinematicNLP evaluates in parallel chunks, see MPC.cpp.
+static const size_t long_horizon = 128;
+
+// The largest difference between two equally long vectors, entry by entry.
+static double largest_difference(const std::vector<Number> &a, const std::vector<Number> &b) {
+    double difference = 0.;
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference = std::max(difference, fabs(a[i] - b[i]));
+    }
+    return difference;
+}
+
+// KinematicNLP over a long horizon, evaluated in chunks on the compute
+// workers against serially, per evaluation and per solve.
+static void bench_parallel() {
+    typedef MPCLayout<long_horizon> Layout;
+    const double dt = 0.1;
+    KinematicNLP<long_horizon> serial(dt, false);
+    KinematicNLP<long_horizon> parallel(dt);
+
+    StateVector state;
+    CoeffVector coeffs;
+    sample_problem(0, state, coeffs);
+    const MPCProblem<long_horizon>::ParamVector params =
+            problem_params<long_horizon>(state, coeffs);
+    serial.SetParameters(params);
+    parallel.SetParameters(params);
+
+    std::vector<Number> x(Layout::n_vars);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = 0.1 * sin(i);
+    }
+    DerivativeCalls serial_calls(serial);
+    DerivativeCalls parallel_calls(parallel);
+    serial_calls.Evaluate(x.data());
+    parallel_calls.Evaluate(x.data());
+    // Both lay out their derivatives the same way. Only the cost is summed
+    // in a different order.
+    double difference = largest_difference(serial_calls.grad, parallel_calls.grad);
+    difference = std::max(difference, largest_difference(serial_calls.g, parallel_calls.g));
+    difference = std::max(difference, largest_difference(serial_calls.jac, parallel_calls.jac));
+    difference = std::max(difference, largest_difference(serial_calls.hes, parallel_calls.hes));
+    printf("parallel: largest difference %g, cost %g apart relatively\n", difference,
+           fabs(serial_calls.f - parallel_calls.f) / fabs(serial_calls.f));
+
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        x[r % x.size()] += 1e-9;
+        serial_calls.Evaluate(x.data());
+    }
+    const double serial_time = microseconds(start, repetitions);
+    start = Clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        x[r % x.size()] += 1e-9;
+        parallel_calls.Evaluate(x.data());
+    }
+    const double parallel_time = microseconds(start, repetitions);
+    printf("parallel: N = %zu, %.2f us per iteration serially, %.2f us in chunks"
+           " (%d compute workers)\n", long_horizon, serial_time, parallel_time,
+           ComputeWorkers().NumThreads());
+
+    const bool parallel_modes[] = {false, true};
+    for (bool parallel_mode : parallel_modes) {
+        IpoptBackend<long_horizon> backend(new KinematicNLP<long_horizon>(dt, parallel_mode));
+        double solve_time = 0.;
+        int iterations = 0;
+        for (int k = 0; k < solve_problems; ++k) {
+            sample_problem(k, state, coeffs);
+            backend.Reset();
+            start = Clock::now();
+            backend.Solve(state, coeffs, Clock::time_point::max());
+            solve_time += microseconds(start, 1);
+            iterations += backend.Iterations();
+        }
+        printf("parallel: %s solves in %.0f us, %.1f iterations, %.1f us per iteration\n",
+               parallel_mode ? "chunked" : "serial", solve_time / solve_problems,
+               (double) iterations / solve_problems, solve_time / std::max(iterations, 1));
+    }
+}
+
+struct Section {
+    const char *name;
+    void (*run)();
+};
+
+static const Section sections[] = {
+    {"derivatives", bench_derivatives},
+    {"polyfit", bench_polyfit},
+    {"telemetry", bench_telemetry},
+    {"parallel", bench_parallel},
+};
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        bool known = false;
+        for (const Section &section : sections) {
+            known = known || strcmp(argv[i], section.name) == 0;
+        }
+        if (!known) {
+            fprintf(stderr, "Usage: %s [<section>...], the sections being", argv[0]);
+            for (const Section &section : sections) {
+                fprintf(stderr, " %s", section.name);
+            }
+            fprintf(stderr, "\n");
+            return -1;
+        }
+    }
+
+    SetLogLevel(LOG_WARN);
+    for (const Section &section : sections) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || strcmp(argv[i], section.name) == 0;
+        }
+        if (selected) {
+            section.run();
+        }
+    }
+    return 0;
+}
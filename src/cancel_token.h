@@ -0,0 +1,47 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+/**
+ * Lets another thread ask the solves in progress to stop early, because
+ * their results are no longer wanted. Solvers poll it between iterations.
+ *
+ * The work is numbered in the order it is submitted, and a solve is
+ * cancelled once work with a later number has been submitted. Comparing
+ * numbers, rather than setting and clearing a flag, cannot cancel the
+ * newest work however the two threads interleave.
+ */
+class CancelToken {
+public:
+    CancelToken() : latest(0), current(0) {}
+
+    /**
+     * Cancels the solves of work numbered below number. Call it once that
+     * work is handed over, with increasing numbers.
+     */
+    void Supersede(uint64_t number) { latest.store(number, std::memory_order_release); }
+
+    /**
+     * Marks the start of the solve of work numbered number.
+     */
+    void Begin(uint64_t number) { current.store(number, std::memory_order_release); }
+
+    /**
+     * Cancels the solve in progress and every later one, for good.
+     */
+    void Cancel() { Supersede(std::numeric_limits<uint64_t>::max()); }
+
+    bool Cancelled() const {
+        return latest.load(std::memory_order_acquire) > current.load(std::memory_order_acquire);
+    }
+
+private:
+    // The number of the newest work submitted, and of the work being solved.
+    std::atomic<uint64_t> latest;
+    std::atomic<uint64_t> current;
+};
+
+#endif /* CANCEL_TOKEN_H */
@@ -0,0 +1,41 @@
+#ifndef COUNTDOWN_H
+#define COUNTDOWN_H
+
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Lets a thread wait for a known number of tasks run on other threads.
+ */
+class CountDown {
+public:
+    /**
+     * @param count  number of Done calls Wait waits for
+     */
+    explicit CountDown(int count) : count(count) {}
+
+    /**
+     * Marks one task as finished.
+     */
+    void Done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--count == 0) {
+            done.notify_all();
+        }
+    }
+
+    /**
+     * Blocks until every task is finished.
+     */
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return count == 0; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable done;
+    int count;
+};
+
+#endif /* COUNTDOWN_H */
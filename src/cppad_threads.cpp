@@ -0,0 +1,88 @@
+#include "cppad_threads.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cppad/cppad.hpp>
+
+namespace {
+
+// Number of open CppADParallelSections.
+std::atomic<int> parallel_sections(0);
+
+// The numbers given back by threads that exited, and the next one never
+// handed out.
+std::mutex numbers_mutex;
+std::vector<size_t> free_numbers;
+size_t next_number = 1;
+
+// The CppAD thread number of a thread, given back when the thread exits.
+struct CppADThread {
+    CppADThread() : number(0), claimed(false), master(false) {}
+
+    ~CppADThread();
+
+    size_t number;
+    bool claimed;
+    bool master;
+};
+
+thread_local CppADThread this_thread;
+
+bool in_parallel() {
+    return parallel_sections.load(std::memory_order_acquire) > 0;
+}
+
+// Outside the parallel sections only the master uses CppAD.
+size_t thread_num() {
+    return in_parallel() ? this_thread.number : 0;
+}
+
+CppADThread::~CppADThread() {
+    if (!claimed || master) {
+        return;
+    }
+    if (in_parallel()) {
+        CppAD::thread_alloc::free_available(number);
+    }
+    std::lock_guard<std::mutex> lock(numbers_mutex);
+    free_numbers.push_back(number);
+}
+
+}  // namespace
+
+void SetUpCppADThreads() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        this_thread.claimed = true;
+        this_thread.master = true;
+        CppAD::thread_alloc::parallel_setup(CPPAD_MAX_NUM_THREADS, in_parallel, thread_num);
+        CppAD::parallel_ad<double>();
+    });
+}
+
+bool ClaimCppADThread() {
+    SetUpCppADThreads();
+    if (this_thread.claimed) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(numbers_mutex);
+    if (!free_numbers.empty()) {
+        this_thread.number = free_numbers.back();
+        free_numbers.pop_back();
+    } else if (next_number < CPPAD_MAX_NUM_THREADS) {
+        this_thread.number = next_number++;
+    } else {
+        return false;
+    }
+    this_thread.claimed = true;
+    return true;
+}
+
+CppADParallelSection::CppADParallelSection() {
+    SetUpCppADThreads();
+    parallel_sections.fetch_add(1, std::memory_order_acq_rel);
+}
+
+CppADParallelSection::~CppADParallelSection() {
+    parallel_sections.fetch_sub(1, std::memory_order_acq_rel);
+}
@@ -0,0 +1,41 @@
+#ifndef CPPAD_THREADS_H
+#define CPPAD_THREADS_H
+
+/**
+ * Puts CppAD in its multithreaded mode, once: every thread gets its own
+ * memory pool and recording tape. The first caller becomes CppAD's master
+ * thread, number 0, so call it on the main thread before any other thread
+ * uses CppAD. CppADParallelSection and ClaimCppADThread call it.
+ */
+void SetUpCppADThreads();
+
+/**
+ * Gives the calling thread a CppAD thread number of its own, if it has none
+ * yet. A thread needs one to record or sweep tapes inside a
+ * CppADParallelSection, and gives it back when it exits.
+ *
+ * There are CPPAD_MAX_NUM_THREADS numbers, 0 being the master's.
+ * @return false if all of them are taken
+ */
+bool ClaimCppADThread();
+
+/**
+ * Keeps CppAD in its parallel mode for as long as it lives, for a pool whose
+ * threads record and sweep tapes. Open it on the master thread before the
+ * pool starts and close it after the pool has stopped; sections may overlap.
+ *
+ * While a section is open each tape is CppAD's business of the thread that
+ * recorded it only: that thread sweeps it and frees it.
+ */
+class CppADParallelSection {
+public:
+    CppADParallelSection();
+
+    ~CppADParallelSection();
+
+private:
+    CppADParallelSection(const CppADParallelSection &);
+    CppADParallelSection &operator=(const CppADParallelSection &);
+};
+
+#endif /* CPPAD_THREADS_H */
@@ -0,0 +1,69 @@
+#include "delayed_sender.h"
+#include <algorithm>
+
+DelayedSender::DelayedSender(uv_loop_t *loop, int delay_ms, int jitter_ms)
+        : loop(loop), delay_ms(std::max(delay_ms, 0)), jitter_ms(std::max(jitter_ms, 0)),
+          random(std::random_device()()) {}
+
+// The sender lives as long as the loop, so the timers are only stopped here;
+// closing them would need the loop to run again.
+DelayedSender::~DelayedSender() {
+    for (size_t i = 0; i < pending.size(); ++i) {
+        uv_timer_stop(&pending[i]->timer);
+    }
+}
+
+void DelayedSender::Send(uWS::WebSocket<uWS::SERVER> ws, const char *message, size_t length) {
+    Pending *slot;
+    if (idle.empty()) {
+        pending.emplace_back(new Pending(ws));
+        slot = pending.back().get();
+        slot->owner = this;
+        uv_timer_init(loop, &slot->timer);
+        slot->timer.data = slot;
+    } else {
+        slot = idle.back();
+        idle.pop_back();
+        slot->ws = ws;
+    }
+    slot->message.assign(message, length);
+    slot->active = true;
+
+    int delay = delay_ms;
+    if (jitter_ms > 0) {
+        std::uniform_int_distribution<int> jitter(-jitter_ms, jitter_ms);
+        delay = std::max(delay + jitter(random), 0);
+    }
+    // Never overtake a message to the same websocket scheduled earlier.
+    const uint64_t now = uv_now(loop);
+    uint64_t due = now + delay;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const Pending *other = pending[i].get();
+        if (other != slot && other->active && other->ws == ws) {
+            due = std::max(due, other->due);
+        }
+    }
+    slot->due = due;
+    uv_timer_start(&slot->timer, &DelayedSender::OnTimer, due - now, 0);
+}
+
+void DelayedSender::Cancel(uWS::WebSocket<uWS::SERVER> ws) {
+    for (size_t i = 0; i < pending.size(); ++i) {
+        Pending *slot = pending[i].get();
+        if (slot->active && slot->ws == ws) {
+            uv_timer_stop(&slot->timer);
+            Release(slot);
+        }
+    }
+}
+
+void DelayedSender::OnTimer(uv_timer_t *timer) {
+    Pending *slot = static_cast<Pending *>(timer->data);
+    slot->ws.send(slot->message.data(), slot->message.length(), uWS::OpCode::TEXT);
+    slot->owner->Release(slot);
+}
+
+void DelayedSender::Release(Pending *slot) {
+    slot->active = false;
+    idle.push_back(slot);
+}
@@ -0,0 +1,67 @@
+#ifndef DELAYED_SENDER_H
+#define DELAYED_SENDER_H
+
+#include <uWS/uWS.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Emulates actuation latency by sending messages after a delay, using timers
+ * on the event loop instead of sleeping in the handler, so the loop keeps
+ * receiving and computing while a message is in flight.
+ *
+ * The messages to one websocket are sent in the order they were scheduled,
+ * even with jitter; those to different websockets do not wait for each other.
+ * Everything runs on the loop's thread.
+ */
+class DelayedSender {
+public:
+    /**
+     * @param loop  the event loop the timers run on
+     * @param delay_ms  the mean delay, in milliseconds
+     * @param jitter_ms  each delay is drawn uniformly within this much of the
+     *                   mean, in milliseconds
+     */
+    DelayedSender(uv_loop_t *loop, int delay_ms, int jitter_ms);
+
+    ~DelayedSender();
+
+    /**
+     * Copies the message and sends it on ws once its delay has passed.
+     */
+    void Send(uWS::WebSocket<uWS::SERVER> ws, const char *message, size_t length);
+
+    /**
+     * Drops the messages still in flight to ws, which is closing.
+     */
+    void Cancel(uWS::WebSocket<uWS::SERVER> ws);
+
+private:
+    // A message in flight. Kept once allocated, with its timer, and reused.
+    struct Pending {
+        explicit Pending(uWS::WebSocket<uWS::SERVER> ws) : ws(ws), due(0), active(false) {}
+
+        uv_timer_t timer;
+        DelayedSender *owner;
+        uWS::WebSocket<uWS::SERVER> ws;
+        std::string message;
+        // When it goes out, in loop time.
+        uint64_t due;
+        bool active;
+    };
+
+    static void OnTimer(uv_timer_t *timer);
+    void Release(Pending *pending);
+
+    uv_loop_t *loop;
+    int delay_ms;
+    int jitter_ms;
+    std::mt19937 random;
+    std::vector<std::unique_ptr<Pending> > pending;
+    std::vector<Pending *> idle;
+};
+
+#endif /* DELAYED_SENDER_H */
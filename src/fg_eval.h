@@ -0,0 +1,92 @@
+#ifndef FG_EVAL_H
+#define FG_EVAL_H
+
+#include <vector>
+#include <cppad/cppad.hpp>
+#include "kinematic_model.h"
+#include "mpc_layout.h"
+
+/**
+ * The MPC objective and model constraints, written once against CppAD and
+ * recorded into the tape MPC_NLP evaluates.
+ */
+template <size_t N>
+class FG_eval {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef std::vector<CppAD::AD<double> > ADvector;
+
+    // Timestep duration, in seconds.
+    const double dt;
+
+    explicit FG_eval(double dt) : dt(dt) {}
+
+    /**
+     * @param fg  a vector of the cost constraints
+     * @param vars  a vector of variable values (state & actuators)
+     * @param params  the initial state, then the fitted polynomial coefficients
+     */
+    void operator()(ADvector &fg, const ADvector &vars, const ADvector &params) {
+        const CppAD::AD<double> *coeffs = &params[n_state];
+
+        // The cost is stored is the first element of `fg`.
+        fg[0] = 0;
+
+        // The part of the cost based on the reference state.
+        for (size_t t = 0; t < N; t++) {
+            fg[0] += cte_weight * CppAD::pow(vars[Layout::cte_start + t] - ref_cte, 2);
+            fg[0] += epsi_weight * CppAD::pow(vars[Layout::epsi_start + t] - ref_epsi, 2);
+            fg[0] += v_weight * CppAD::pow(vars[Layout::v_start + t] - ref_v, 2);
+        }
+
+        // Minimize the use of actuators.
+        for (size_t t = 0; t < N - 1; t++) {
+            fg[0] += delta_weight * CppAD::pow(vars[Layout::delta_start + t], 2);
+            fg[0] += accel_weight * CppAD::pow(vars[Layout::accel_start + t], 2);
+        }
+
+        // Minimize the value gap between sequential actuations.
+        for (size_t t = 0; t < N - 2; t++) {
+            fg[0] += delta_change_weight * CppAD::pow(vars[Layout::delta_start + t + 1] - vars[Layout::delta_start + t], 2);
+            fg[0] += accel_change_weight * CppAD::pow(vars[Layout::accel_start + t + 1] - vars[Layout::accel_start + t], 2);
+        }
+
+        ///////////////////////
+        // Setup Constraints //
+        ///////////////////////
+
+        // Initial constraints
+        //
+        // We add 1 to each of the starting indices due to cost being located at
+        // index 0 of `fg`.
+        // This bumps up the position of all the other values.
+        // The initial state is a parameter of the tape, so these are pinned to
+        // 0 rather than to the state through the constraint bounds.
+        for (size_t i = 0; i < n_state; ++i) {
+            fg[1 + Layout::x_start + i * N] = vars[Layout::x_start + i * N] - params[i];
+        }
+
+        // The rest of the constraints, over time
+        for (size_t t = 1; t < N; ++t) {
+            // The state at time t, and the state the model predicts for t+1.
+            CppAD::AD<double> state0[n_state];
+            CppAD::AD<double> state1[n_state];
+            for (size_t i = 0; i < n_state; ++i) {
+                state0[i] = vars[Layout::x_start + i * N + t - 1];
+            }
+
+            // Only consider the actuation at time t.
+            CppAD::AD<double> delta0 = vars[Layout::delta_start + t - 1];
+            CppAD::AD<double> a0 = vars[Layout::accel_start + t - 1];
+
+            kinematic_step(state1, state0, delta0, a0, coeffs, dt);
+
+            // The idea here is to constraint this value to be 0.
+            for (size_t i = 0; i < n_state; ++i) {
+                fg[1 + Layout::x_start + i * N + t] = vars[Layout::x_start + i * N + t] - state1[i];
+            }
+        }
+    }
+};
+
+#endif /* FG_EVAL_H */
@@ -0,0 +1,345 @@
+#include "ilqr.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "Eigen-3.3/Eigen/LU"
+#include "polynomial.h"
+
+static const int max_iterations = 50;
+// Relative cost decrease below which the iterations stop.
+static const double cost_tolerance = 1e-7;
+// Step lengths tried by the line search: 1, 1/2, ..., 1/2^(line_search_steps - 1).
+static const int line_search_steps = 10;
+static const double min_regularization = 1e-6;
+static const double max_regularization = 1e10;
+// Points of the last polynomial refit in the predicted car frame, and the
+// shortest stretch of road they cover, in meters.
+static const int prediction_points = 8;
+static const double min_prediction_span = 1.;
+
+template <size_t N>
+ILQR<N>::ILQR(double dt, bool real_time_iteration)
+        : obj_value(0.), iterations(0), deadline_hit(false), dt(dt),
+          real_time_iteration(real_time_iteration), has_plan(false), u_max(M::MaxActuation()),
+          expected_decrease(0.), prepared(false), last_coeffs(CoeffVector::Zero()) {
+    solution_x.fill(0.);
+    for (size_t t = 0; t < N - 1; ++t) {
+        u[t].setZero();
+        M::InitLinearization(A[t], B[t]);
+    }
+}
+
+template <size_t N>
+void ILQR<N>::Reset() {
+    has_plan = false;
+    prepared = false;
+}
+
+template <size_t N>
+double ILQR<N>::Cost(const std::array<ZVector, N> &z, const std::array<UVector, N - 1> &u) const {
+    // Stage costs without the constant terms, which do not matter for the
+    // line search.
+    double J = 0;
+    for (size_t t = 0; t < N - 1; ++t) {
+        J += 0.5 * z[t].dot(cost.Q[t] * z[t]) + cost.q_ref.dot(z[t])
+             + 0.5 * u[t].dot(cost.R[t] * u[t]) + u[t].dot(cost.S[t] * z[t]);
+    }
+    J += 0.5 * z[N - 1].dot(cost.Q[N - 1] * z[N - 1]) + cost.q_ref.dot(z[N - 1]);
+    return J;
+}
+
+template <size_t N>
+double ILQR<N>::Rollout(std::array<ZVector, N> &z, const std::array<UVector, N - 1> &u,
+                        const double *coeffs) const {
+    for (size_t t = 0; t < N - 1; ++t) {
+        M::Step(z[t + 1], z[t], u[t], coeffs, dt);
+    }
+    return Cost(z, u);
+}
+
+template <size_t N>
+double ILQR<N>::ForwardPass(double alpha, const double *coeffs) {
+    for (size_t t = 0; t < N - 1; ++t) {
+        const UVector candidate = u[t] + alpha * k[t] + K[t] * (z_new[t] - z[t]);
+        u_new[t] = candidate.cwiseMax(-u_max).cwiseMin(u_max);
+        M::Step(z_new[t + 1], z_new[t], u_new[t], coeffs, dt);
+    }
+    return Cost(z_new, u_new);
+}
+
+template <size_t N>
+typename ILQR<N>::UVector ILQR<N>::BoxQP(const UUMatrix &H, const UVector &g,
+                                         const UVector &lower, const UVector &upper,
+                                         Eigen::Matrix<bool, M::nu, 1> &free) {
+    // Each actuation is either free, at its lower or at its upper bound. The
+    // QP is convex, so its minimizer is the best feasible candidate.
+    UVector best = UVector::Zero();
+    double best_value = std::numeric_limits<double>::infinity();
+    free.setConstant(false);
+
+    for (int active0 = 0; active0 < 3; ++active0) {
+        for (int active1 = 0; active1 < 3; ++active1) {
+            const int active[M::nu] = {active0, active1};
+            UVector d;
+            int n_free = 0;
+            int free_index = 0;
+            for (int i = 0; i < M::nu; ++i) {
+                if (active[i] == 0) {
+                    d(i) = 0.;
+                    ++n_free;
+                    free_index = i;
+                } else {
+                    d(i) = active[i] == 1 ? lower(i) : upper(i);
+                }
+            }
+
+            if (n_free == M::nu) {
+                d = -H.inverse() * g;
+            } else if (n_free == 1) {
+                const int i = free_index;
+                const int j = 1 - i;
+                d(i) = -(g(i) + H(i, j) * d(j)) / H(i, i);
+            }
+
+            bool feasible = true;
+            for (int i = 0; i < M::nu; ++i) {
+                feasible &= d(i) >= lower(i) - 1e-12 && d(i) <= upper(i) + 1e-12;
+            }
+            const double value = 0.5 * d.dot(H * d) + g.dot(d);
+            if (feasible && value < best_value) {
+                best = d;
+                best_value = value;
+                free << (active0 == 0), (active1 == 0);
+            }
+        }
+    }
+    return best;
+}
+
+template <size_t N>
+bool ILQR<N>::BackwardPass(double regularization) {
+    ZZMatrix P = cost.Q[N - 1];
+    ZVector p = cost.Q[N - 1] * z[N - 1] + cost.q_ref;
+    expected_decrease = 0;
+
+    for (size_t i = N - 1; i-- > 0;) {
+        const ZVector gz = cost.Q[i] * z[i] + cost.q_ref + cost.S[i].transpose() * u[i];
+        const UVector gu = cost.R[i] * u[i] + cost.S[i] * z[i];
+
+        const ZZMatrix PA = P * A[i];
+        const ZUMatrix PB = P * B[i];
+        const ZZMatrix Qzz = cost.Q[i] + A[i].transpose() * PA;
+        const UZMatrix Quz = cost.S[i] + B[i].transpose() * PA;
+        const ZVector qz = gz + A[i].transpose() * p;
+        const UVector qu = gu + B[i].transpose() * p;
+        const UUMatrix Quu = cost.R[i] + B[i].transpose() * PB
+                             + regularization * UUMatrix::Identity();
+
+        if (Quu.llt().info() != Eigen::Success) {
+            return false;
+        }
+
+        // Feedforward from the box QP on the actuation step, feedback only on
+        // the actuations it leaves off their bounds.
+        Eigen::Matrix<bool, M::nu, 1> free;
+        k[i] = BoxQP(Quu, qu, -u_max - u[i], u_max - u[i], free);
+        K[i].setZero();
+        if (free.all()) {
+            K[i] = -Quu.inverse() * Quz;
+        } else {
+            for (int j = 0; j < M::nu; ++j) {
+                if (free(j)) {
+                    K[i].row(j) = -Quz.row(j) / Quu(j, j);
+                }
+            }
+        }
+
+        expected_decrease -= k[i].dot(qu) + 0.5 * k[i].dot(Quu * k[i]);
+
+        p = qz + K[i].transpose() * (Quu * k[i] + qu) + Quz.transpose() * k[i];
+        P = Qzz + K[i].transpose() * Quu * K[i] + K[i].transpose() * Quz
+            + Quz.transpose() * K[i];
+        P = 0.5 * (P + P.transpose()).eval();
+    }
+    return true;
+}
+
+template <size_t N>
+void ILQR<N>::ShiftPlan() {
+    std::rotate(u.begin(), u.begin() + 1, u.end());
+    u[N - 2] = u[N - 3];
+}
+
+template <size_t N>
+SolveStatus ILQR<N>::Solve(const StateVector &state, const CoeffVector &coeffs,
+                           std::chrono::steady_clock::time_point deadline) {
+    last_coeffs = coeffs;
+    if (real_time_iteration && (prepared || Prepare(coeffs)) && Feedback(state, coeffs)) {
+        // One Gauss-Newton step, not a converged solve.
+        return SOLVE_FEASIBLE;
+    }
+    if (Optimize(state, coeffs, deadline)) {
+        return SOLVE_CONVERGED;
+    }
+    // Every iterate is a feasible plan.
+    return deadline_hit ? SOLVE_DEADLINE_FEASIBLE : SOLVE_FAILED;
+}
+
+template <size_t N>
+bool ILQR<N>::Optimize(const StateVector &state, const CoeffVector &coeffs,
+                    std::chrono::steady_clock::time_point deadline) {
+    if (has_plan) {
+        ShiftPlan();
+    } else {
+        for (size_t t = 0; t < N - 1; ++t) {
+            u[t].setZero();
+        }
+    }
+
+    z[0].template head<n_state>() = state.head<n_state>();
+    z[0].template tail<M::nu>().setZero();
+    z_new[0] = z[0];
+    double J = Rollout(z, u, coeffs.data());
+
+    double regularization = 0;
+    bool converged = false;
+    deadline_hit = false;
+    for (iterations = 0; iterations < max_iterations && !converged; ++iterations) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            deadline_hit = true;
+            break;
+        }
+        for (size_t t = 0; t < N - 1; ++t) {
+            M::Linearize(A[t], B[t], z[t], u[t], coeffs.data(), dt);
+        }
+
+        if (!BackwardPass(regularization)) {
+            regularization = std::max(10 * regularization, min_regularization);
+            if (regularization > max_regularization) {
+                break;
+            }
+            continue;
+        }
+
+        bool accepted = false;
+        double alpha = 1.;
+        for (int step = 0; step < line_search_steps && !accepted; ++step, alpha *= 0.5) {
+            const double J_new = ForwardPass(alpha, coeffs.data());
+            if (J_new < J) {
+                accepted = true;
+                converged = J - J_new < cost_tolerance * (1 + std::abs(J));
+                J = J_new;
+                z.swap(z_new);
+                u.swap(u_new);
+            }
+        }
+
+        if (accepted) {
+            regularization = regularization > min_regularization ? regularization / 10 : 0;
+        } else {
+            // No descent left along the current gains: either the cost has
+            // converged, or the model needs more damping.
+            converged = expected_decrease < cost_tolerance * (1 + std::abs(J));
+            regularization = std::max(10 * regularization, min_regularization);
+            if (regularization > max_regularization) {
+                break;
+            }
+        }
+    }
+
+    obj_value = augmented_to_vars<N>(solution_x, z, u);
+    has_plan = converged || deadline_hit;
+    return converged;
+}
+
+template <size_t N>
+void ILQR<N>::PrepareNext() {
+    if (real_time_iteration && !prepared && has_plan) {
+        Prepare(PredictCoeffs());
+    }
+}
+
+template <size_t N>
+CoeffVector ILQR<N>::PredictCoeffs() const {
+    typedef Eigen::Matrix<double, prediction_points, 1> Points;
+
+    // Sample the road over the rest of the plan, and a bit beyond where the
+    // next plan reaches, then move the samples into the frame of the pose the
+    // plan predicts for t = 1.
+    const double x1 = z[1][0];
+    const double y1 = z[1][1];
+    const double c = cos(z[1][2]);
+    const double s = sin(z[1][2]);
+    const double span = std::max(2 * (z[N - 1][0] - x1), min_prediction_span);
+    Points x;
+    Points y;
+    for (int i = 0; i < prediction_points; ++i) {
+        const double px = x1 + span * i / (prediction_points - 1);
+        const double dx = px - x1;
+        const double dy = polyeval(last_coeffs, px) - y1;
+        x[i] = c * dx + s * dy;
+        y[i] = -s * dx + c * dy;
+    }
+    return polyfit<prediction_points>(x, y);
+}
+
+template <size_t N>
+bool ILQR<N>::Prepare(const CoeffVector &coeffs) {
+    prepared = false;
+    if (!has_plan) {
+        return false;
+    }
+
+    // The car frame moves with the car, so if it follows the plan it starts
+    // the next tick at the origin, heading along x, with the speed and errors
+    // the plan predicted for t = 1.
+    const ZVector predicted = z[1];
+    ShiftPlan();
+    z[0].setZero();
+    z[0].template segment<3>(3) = predicted.template segment<3>(3);
+
+    std::copy(coeffs.data(), coeffs.data() + n_coeffs, prepared_coeffs.begin());
+    Rollout(z, u, prepared_coeffs.data());
+    for (size_t t = 0; t < N - 1; ++t) {
+        M::Linearize(A[t], B[t], z[t], u[t], prepared_coeffs.data(), dt);
+    }
+
+    // The regularization only grows a bounded number of times, so the
+    // preparation work stays bounded too.
+    for (double regularization = 0; !BackwardPass(regularization);
+         regularization = std::max(10 * regularization, min_regularization)) {
+        if (regularization > max_regularization) {
+            has_plan = false;
+            return false;
+        }
+    }
+    prepared = true;
+    return true;
+}
+
+template <size_t N>
+bool ILQR<N>::Feedback(const StateVector &state, const CoeffVector &coeffs) {
+    if (!prepared) {
+        return false;
+    }
+
+    // A full step along the prepared gains, from the measured state and
+    // along the measured road.
+    z_new[0].template head<n_state>() = state.head<n_state>();
+    z_new[0].template tail<M::nu>().setZero();
+    ForwardPass(1., coeffs.data());
+    z.swap(z_new);
+    u.swap(u_new);
+
+    iterations = 1;
+    obj_value = augmented_to_vars<N>(solution_x, z, u);
+    prepared = false;
+    return true;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class ILQR<10>;
+template class ILQR<15>;
+template class ILQR<20>;
+template class ILQR<128>;
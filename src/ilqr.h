@@ -0,0 +1,187 @@
+#ifndef ILQR_H
+#define ILQR_H
+
+#include <array>
+#include <chrono>
+#include "Eigen-3.3/Eigen/Core"
+#include "augmented_model.h"
+#include "mpc_layout.h"
+#include "solver_backend.h"
+
+/**
+ * Iterative LQR for the kinematic model, with the actuator limits handled in
+ * the backward pass (control-limited DDP): each stage solves a small box QP
+ * for its feedforward step and only feeds back on the actuations left free.
+ *
+ * Every iteration is one O(N) backward pass over fixed-size blocks plus a line
+ * searched nonlinear rollout, with no sparse matrices and no allocation. It
+ * works on the AugmentedModel, so dynamics and cost are the ones FG_eval tapes.
+ */
+template <size_t N>
+class ILQR : public SolverBackend<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename SolverBackend<N>::VarVector VarVector;
+    typedef AugmentedModel M;
+    typedef M::ZVector ZVector;
+    typedef M::UVector UVector;
+    typedef M::ZZMatrix ZZMatrix;
+    typedef M::ZUMatrix ZUMatrix;
+    typedef M::UZMatrix UZMatrix;
+    typedef M::UUMatrix UUMatrix;
+
+    /**
+     * @param dt  timestep duration, in seconds
+     * @param real_time_iteration  whether Solve runs one real-time iteration
+     *                             (Prepare then Feedback) instead of Optimize
+     */
+    explicit ILQR(double dt, bool real_time_iteration = false);
+
+    /**
+     * Optimizes, or runs one real-time iteration: only the Feedback if
+     * PrepareNext ran since the last solve, both phases otherwise. Real-time
+     * iterations need a plan to start from, so the first tick (or one after a
+     * failure) optimizes.
+     */
+    SolveStatus Solve(const StateVector &state, const CoeffVector &coeffs,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+    /**
+     * In real-time iteration mode, Prepares the next tick with the last
+     * solve's polynomial moved into the car frame the plan predicts, the best
+     * guess until the next one arrives.
+     */
+    void PrepareNext() override;
+
+    const VarVector &Solution() const override { return solution_x; }
+
+    double Cost() const override { return obj_value; }
+
+    int Iterations() const override { return iterations; }
+
+    /**
+     * Optimizes the actuations, starting from the previous plan shifted by
+     * one step (or zero actuations if there is none). Every iteration keeps
+     * a feasible plan, so stopping at the deadline leaves the best one so far.
+     * @param state  x, y, psi, v, cte, epsi
+     * @param coeffs  the fitted polynomial
+     * @param deadline  wall-clock time after which no new iteration starts
+     * @return whether the cost converged
+     */
+    bool Optimize(const StateVector &state, const CoeffVector &coeffs,
+                  std::chrono::steady_clock::time_point deadline =
+                          std::chrono::steady_clock::time_point::max());
+
+    /**
+     * Real-time iteration, preparation phase: shifts the previous plan, then
+     * linearizes and runs the backward pass around it from the state the plan
+     * predicts for this tick. Does not need the measured state.
+     * @param coeffs  the fitted polynomial
+     * @return false if there is no previous plan to prepare from
+     */
+    bool Prepare(const CoeffVector &coeffs);
+
+    /**
+     * Real-time iteration, feedback phase: one full step along the prepared
+     * gains from the measured state, a single O(N) rollout with no iterations.
+     * @param state  x, y, psi, v, cte, epsi
+     * @param coeffs  the fitted polynomial, which the rollout follows even if
+     *                the gains were prepared with an older one
+     * @return false if Prepare did not succeed since the last Feedback
+     */
+    bool Feedback(const StateVector &state, const CoeffVector &coeffs);
+
+    /**
+     * Forgets the previous plan.
+     */
+    void Reset() override;
+
+    // The plan from the last solve, in the same layout as the Ipopt variables.
+    VarVector solution_x;
+    double obj_value;
+    int iterations;
+    // Whether the last Optimize stopped at its deadline.
+    bool deadline_hit;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    /**
+     * @return the cost of the trajectory, up to a constant
+     */
+    double Cost(const std::array<ZVector, N> &z, const std::array<UVector, N - 1> &u) const;
+
+    /**
+     * Runs the nonlinear model from z[0] under u, into z.
+     * @return the cost of the resulting trajectory
+     */
+    double Rollout(std::array<ZVector, N> &z, const std::array<UVector, N - 1> &u,
+                   const double *coeffs) const;
+
+    /**
+     * Computes the gains around the current trajectory, and the cost
+     * decrease they predict.
+     * @return false if a stage Hessian was not positive definite
+     */
+    bool BackwardPass(double regularization);
+
+    /**
+     * Rolls the gains out from z_new[0] into z_new and u_new, taking alpha of
+     * the feedforward step.
+     * @return the cost of the new trajectory
+     */
+    double ForwardPass(double alpha, const double *coeffs);
+
+    /**
+     * Shifts the actuations one timestep ahead, repeating the last one.
+     */
+    void ShiftPlan();
+
+    /**
+     * @return the last polynomial, refit in the car frame the plan predicts
+     *         for the next tick
+     */
+    CoeffVector PredictCoeffs() const;
+
+    /**
+     * Solves min 1/2 d'Hd + g'd subject to lower <= d <= upper exactly, by
+     * trying every active set of the two actuations.
+     * @param free  receives which actuations are not at a bound
+     */
+    static UVector BoxQP(const UUMatrix &H, const UVector &g, const UVector &lower,
+                         const UVector &upper, Eigen::Matrix<bool, M::nu, 1> &free);
+
+    const double dt;
+    const bool real_time_iteration;
+    bool has_plan;
+    const AugmentedCost<N> cost;
+    const UVector u_max;
+
+    // Current trajectory, and the line search candidate.
+    std::array<ZVector, N> z, z_new;
+    std::array<UVector, N - 1> u, u_new;
+
+    // Dynamics linearized along the current trajectory.
+    std::array<ZZMatrix, N - 1> A;
+    std::array<ZUMatrix, N - 1> B;
+
+    // Feedforward and feedback gains.
+    std::array<UVector, N - 1> k;
+    std::array<UZMatrix, N - 1> K;
+    // Cost decrease the last backward pass predicts for a full step.
+    double expected_decrease;
+
+    // Whether the gains are prepared for a Feedback, and the polynomial they
+    // were prepared with.
+    bool prepared;
+    std::array<double, n_coeffs> prepared_coeffs;
+    // The polynomial of the last solve, for PrepareNext.
+    CoeffVector last_coeffs;
+};
+
+extern template class ILQR<10>;
+extern template class ILQR<15>;
+extern template class ILQR<20>;
+extern template class ILQR<128>;
+
+#endif /* ILQR_H */
@@ -0,0 +1,258 @@
+#include "ipopt_backend.h"
+#include <cmath>
+#include <mutex>
+#include "kinematic_model.h"
+#include "logger.h"
+
+// Moves a block of `length` per-timestep values one step forward in time,
+// repeating the last value to fill the end of the horizon.
+template <class Vector>
+static void shift_block(const Vector &from, Vector &to, size_t start, size_t length) {
+    for (size_t t = 0; t + 1 < length; ++t) {
+        to[start + t] = from[start + t + 1];
+    }
+    to[start + length - 1] = from[start + length - 1];
+}
+
+// MUMPS, the linear solver Ipopt uses by default, keeps global state and is
+// not re-entrant. Solves that use it take turns, whichever thread and
+// controller they run on; the other linear solvers do not need the lock.
+static std::timed_mutex mumps_mutex;
+
+template <size_t N>
+IpoptBackend<N>::IpoptBackend(const Ipopt::SmartPtr<MPCProblem<N> > &nlp,
+                              const char *linear_solver)
+        : warm_start(false), options_warm_start(false), warm_start_duals(false), iterations(0),
+          cancel(NULL), uses_mumps(linear_solver == NULL),
+          app_status(Ipopt::Solve_Succeeded), nlp(nlp) {
+    // Set all non-actuators upper and lowerlimits
+    // to the max negative and positive values.
+    for (size_t i = 0; i < Layout::delta_start; i++) {
+        nlp->vars_lowerbound[i] = -1.0e19;
+        nlp->vars_upperbound[i] = 1.0e19;
+    }
+
+    // The upper and lower limits of delta are set to -25 and 25
+    // degrees (values in radians).
+    for (size_t i = Layout::delta_start; i < Layout::accel_start; i++) {
+        // NOTE: Still not sure if *Lf should be included or not...
+        nlp->vars_lowerbound[i] = -max_delta;
+        nlp->vars_upperbound[i] = max_delta;
+    }
+
+    // Acceleration/decceleration upper and lower limits.
+    for (size_t i = Layout::accel_start; i < Layout::n_vars; i++) {
+        nlp->vars_lowerbound[i] = -max_accel;
+        nlp->vars_upperbound[i] = max_accel;
+    }
+
+    // Lower and upper limits for the constraints
+    // All 0, the initial state is folded into the constraints themselves.
+    for (size_t i = 0; i < Layout::n_constraints; i++) {
+        nlp->constraints_lowerbound[i] = 0;
+        nlp->constraints_upperbound[i] = 0;
+    }
+
+    // options for IPOPT solver
+    app = IpoptApplicationFactory();
+    // Uncomment this if you'd like more print information
+    app->Options()->SetIntegerValue("print_level", 0);
+    app->Options()->SetStringValue("sb", "yes");
+    // No time limit here; each Solve stops Ipopt at its own wall-clock
+    // deadline, see MPCProblem::intermediate_callback.
+    // Keep a warm started iterate close to the shifted previous solution
+    // instead of pushing it back into the interior.
+    app->Options()->SetNumericValue("warm_start_bound_push", 1e-6);
+    app->Options()->SetNumericValue("warm_start_slack_bound_push", 1e-6);
+    app->Options()->SetNumericValue("warm_start_mult_bound_push", 1e-6);
+    if (linear_solver != NULL) {
+        app->Options()->SetStringValue("linear_solver", linear_solver);
+    }
+    SetWarmStartOptions(false);
+
+    if (app->Initialize() != Ipopt::Solve_Succeeded) {
+        Log(LOG_WARN, "WARN: Failed to initialize Ipopt!");
+    }
+}
+
+template <size_t N>
+IpoptBackend<N>::~IpoptBackend() {}
+
+template <size_t N>
+void IpoptBackend<N>::SetWarmStartOptions(bool warm) {
+    app->Options()->SetStringValue("warm_start_init_point", warm ? "yes" : "no");
+    app->Options()->SetNumericValue("mu_init", warm ? 1e-6 : 0.1);
+    options_warm_start = warm;
+}
+
+template <size_t N>
+void IpoptBackend<N>::WarmStart(const StateVector &state) {
+    const VarVector &prev = nlp->solution_x;
+    VarVector &vars = nlp->vars;
+
+    // Everything moves one step forward in time, the previous plan's second
+    // step becomes the new first one.
+    for (size_t start = Layout::x_start; start < Layout::delta_start; start += N) {
+        shift_block(prev, vars, start, N);
+        shift_block(nlp->solution_lambda, nlp->lambda, start, N);
+    }
+    shift_block(prev, vars, Layout::delta_start, N - 1);
+    shift_block(prev, vars, Layout::accel_start, N - 1);
+    for (size_t start = Layout::x_start; start < Layout::delta_start; start += N) {
+        shift_block(nlp->solution_z_L, nlp->z_L, start, N);
+        shift_block(nlp->solution_z_U, nlp->z_U, start, N);
+    }
+    shift_block(nlp->solution_z_L, nlp->z_L, Layout::delta_start, N - 1);
+    shift_block(nlp->solution_z_U, nlp->z_U, Layout::delta_start, N - 1);
+    shift_block(nlp->solution_z_L, nlp->z_L, Layout::accel_start, N - 1);
+    shift_block(nlp->solution_z_U, nlp->z_U, Layout::accel_start, N - 1);
+
+    // The previous plan is expressed relative to the previous pose. Move it
+    // rigidly so that its (predicted) first pose lands on the measured one.
+    const double px = prev[Layout::x_start + 1];
+    const double py = prev[Layout::y_start + 1];
+    const double dpsi = state[2] - prev[Layout::psi_start + 1];
+    const double c = cos(dpsi);
+    const double s = sin(dpsi);
+    for (size_t t = 0; t < N; ++t) {
+        const double dx = vars[Layout::x_start + t] - px;
+        const double dy = vars[Layout::y_start + t] - py;
+        vars[Layout::x_start + t] = state[0] + c * dx - s * dy;
+        vars[Layout::y_start + t] = state[1] + s * dx + c * dy;
+        vars[Layout::psi_start + t] += dpsi;
+    }
+}
+
+template <size_t N>
+SolveStatus IpoptBackend<N>::Solve(const StateVector &state, const CoeffVector &coeffs,
+                                   std::chrono::steady_clock::time_point deadline) {
+    // Initial value of the independent variables.
+    // The previous solution shifted by one step if we have one, otherwise
+    // SHOULD BE 0 besides initial state.
+    if (warm_start) {
+        WarmStart(state);
+    } else {
+        for (size_t i = 0; i < Layout::n_vars; i++) {
+            nlp->vars[i] = 0.;
+        }
+    }
+    return Optimize(state, coeffs, deadline, warm_start && warm_start_duals);
+}
+
+template <size_t N>
+SolveStatus IpoptBackend<N>::SolveFrom(const VarVector &start, const StateVector &state,
+                                       const CoeffVector &coeffs,
+                                       std::chrono::steady_clock::time_point deadline) {
+    nlp->vars = start;
+    return Optimize(state, coeffs, deadline, false);
+}
+
+template <size_t N>
+void IpoptBackend<N>::Adopt(const IpoptBackend &other) {
+    nlp->solution_x = other.nlp->solution_x;
+    nlp->solution_z_L = other.nlp->solution_z_L;
+    nlp->solution_z_U = other.nlp->solution_z_U;
+    nlp->solution_lambda = other.nlp->solution_lambda;
+    nlp->obj_value = other.nlp->obj_value;
+    warm_start = other.warm_start;
+    warm_start_duals = other.warm_start_duals;
+}
+
+template <size_t N>
+bool IpoptBackend<N>::CheckLinearSolver() {
+    const StateVector state = StateVector::Zero();
+    const CoeffVector coeffs = CoeffVector::Zero();
+    nlp->vars.fill(0.);
+    const CancelToken *solve_cancel = cancel;
+    cancel = NULL;
+    Optimize(state, coeffs, std::chrono::steady_clock::time_point::max(), false);
+    cancel = solve_cancel;
+    Reset();
+    return app_status == Ipopt::Solve_Succeeded
+           || app_status == Ipopt::Solved_To_Acceptable_Level;
+}
+
+template <size_t N>
+SolveStatus IpoptBackend<N>::Optimize(const StateVector &state, const CoeffVector &coeffs,
+                                      std::chrono::steady_clock::time_point deadline,
+                                      bool warm) {
+    typedef MPCProblem<N> NLP;
+    typename NLP::VarVector &vars = nlp->vars;
+
+    // Set the initial variable values
+
+    const double x     = state[0];
+    const double y     = state[1];
+    const double psi   = state[2];
+    const double v     = state[3];
+    const double cte   = state[4];
+    const double epsi  = state[5];
+
+    vars[Layout::x_start]     = x;
+    vars[Layout::y_start]     = y;
+    vars[Layout::psi_start]   = psi;
+    vars[Layout::v_start]     = v;
+    vars[Layout::cte_start]   = cte;
+    vars[Layout::epsi_start]  = epsi;
+
+    // Swap the new state and polynomial into the tape.
+    typename NLP::ParamVector params;
+    for (size_t i = 0; i < n_state; i++) {
+        params[i] = state[i];
+    }
+    for (size_t i = 0; i < n_coeffs; i++) {
+        params[n_state + i] = coeffs[i];
+    }
+    nlp->SetParameters(params);
+
+    // solve the problem
+    if (warm != options_warm_start) {
+        SetWarmStartOptions(warm);
+    }
+    nlp->SetDeadline(deadline, cancel);
+    {
+        // Waiting for the other MUMPS solves counts against the deadline. A
+        // solve that cannot start in time keeps the previous solution.
+        std::unique_lock<std::timed_mutex> lock(mumps_mutex, std::defer_lock);
+        if (uses_mumps && (std::chrono::steady_clock::now() >= deadline
+                           || !lock.try_lock_until(deadline))) {
+            iterations = 0;
+            return SOLVE_DEADLINE_INFEASIBLE;
+        }
+        app_status = app->OptimizeTNLP(nlp);
+    }
+    // No statistics if Ipopt failed before iterating.
+    Ipopt::SmartPtr<Ipopt::SolveStatistics> statistics = app->Statistics();
+    iterations = Ipopt::IsValid(statistics) ? statistics->IterationCount() : 0;
+
+    SolveStatus result;
+    if (nlp->status == Ipopt::SUCCESS) {
+        result = SOLVE_CONVERGED;
+    } else if (nlp->deadline_hit && nlp->has_feasible_iterate) {
+        // Ipopt hands back the iterate it stopped at; the best feasible one
+        // is the better plan.
+        nlp->solution_x = nlp->best_x;
+        nlp->obj_value = nlp->best_obj_value;
+        result = SOLVE_DEADLINE_FEASIBLE;
+    } else if (nlp->deadline_hit) {
+        result = SOLVE_DEADLINE_INFEASIBLE;
+    } else if (nlp->cancelled) {
+        result = SOLVE_CANCELLED;
+    } else {
+        result = SOLVE_FAILED;
+    }
+
+    // Only a feasible solution is worth warm starting the next tick from, or
+    // the iterate of a solve cut short by newer telemetry, which is on its way
+    // to one and comes with its multipliers.
+    warm_start = result == SOLVE_CONVERGED || result == SOLVE_DEADLINE_FEASIBLE
+                 || result == SOLVE_CANCELLED;
+    warm_start_duals = result != SOLVE_DEADLINE_FEASIBLE;
+    return result;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class IpoptBackend<10>;
+template class IpoptBackend<15>;
+template class IpoptBackend<20>;
+template class IpoptBackend<128>;
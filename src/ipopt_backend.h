@@ -0,0 +1,123 @@
+#ifndef IPOPT_BACKEND_H
+#define IPOPT_BACKEND_H
+
+#include <coin/IpIpoptApplication.hpp>
+#include "mpc_problem.h"
+#include "solver_backend.h"
+
+/**
+ * Solves the MPC problem with Ipopt, for any way of evaluating it (CppAD tape
+ * or analytic derivatives).
+ *
+ * Each solve is warm started from the previous tick's solution, shifted by one
+ * timestep, and stops at its deadline or when cancelled. A cancelled solve's
+ * last iterate warm starts the next one.
+ *
+ * Ipopt's default linear solver (MUMPS) is not re-entrant, so solves of
+ * different backends that use it never overlap: one waits for the other, and
+ * gives up without solving once its deadline passes. Backends given a
+ * re-entrant linear solver, such as MA27, do not wait.
+ */
+template <size_t N>
+class IpoptBackend : public SolverBackend<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename SolverBackend<N>::VarVector VarVector;
+
+    /**
+     * Sets up the bounds of nlp and an Ipopt application for it.
+     * @param nlp  the problem, parameterized by initial state and polynomial
+     * @param linear_solver  a re-entrant linear solver for Ipopt to use, such
+     *                       as reentrant_linear_solver, or NULL for MUMPS
+     */
+    explicit IpoptBackend(const Ipopt::SmartPtr<MPCProblem<N> > &nlp,
+                          const char *linear_solver = NULL);
+
+    virtual ~IpoptBackend();
+
+    SolveStatus Solve(const StateVector &state, const CoeffVector &coeffs,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+    /**
+     * Like Solve, but cold started from the given plan instead of the
+     * previous solution.
+     * @param start  the starting point, whose initial state is replaced by
+     *               state
+     */
+    SolveStatus SolveFrom(const VarVector &start, const StateVector &state,
+                          const CoeffVector &coeffs,
+                          std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * Takes over the last solution of other, with its multipliers, as the one
+     * the next Solve is warm started from.
+     */
+    void Adopt(const IpoptBackend &other);
+
+    /**
+     * Runs a cold solve of a car at rest on a straight road, to find out
+     * whether Ipopt can load the linear solver; it only tries when solving.
+     * Forgets the solve afterwards.
+     * @return whether the solve converged, as it does unless the linear
+     *         solver is missing
+     */
+    bool CheckLinearSolver();
+
+    void Reset() override { warm_start = false; }
+
+    void SetCancelToken(const CancelToken *token) override { cancel = token; }
+
+    const VarVector &Solution() const override { return nlp->solution_x; }
+
+    double Cost() const override { return nlp->obj_value; }
+
+    int Iterations() const override { return iterations; }
+
+private:
+    /**
+     * Seeds the starting point and multipliers with the previous solution,
+     * shifted by one timestep and moved onto the new initial state.
+     */
+    void WarmStart(const StateVector &state);
+
+    /**
+     * Switches Ipopt's starting point and initial barrier parameter between
+     * cold and warm starts. Setting options allocates, so Solve only calls
+     * this when the mode changes.
+     */
+    void SetWarmStartOptions(bool warm);
+
+    /**
+     * Runs Ipopt from the starting point in nlp->vars, with the initial state
+     * put in, and keeps the result.
+     * @param warm  whether the multipliers were seeded too
+     */
+    SolveStatus Optimize(const StateVector &state, const CoeffVector &coeffs,
+                         std::chrono::steady_clock::time_point deadline, bool warm);
+
+    // Whether the last solve was feasible and can seed the next one, and
+    // which mode the Ipopt options are currently set for.
+    bool warm_start;
+    bool options_warm_start;
+    // Whether the multipliers of the last solution belong to its plan. Not
+    // when a deadline swapped in the best feasible iterate, whose multipliers
+    // Ipopt does not hand out; the next solve then only reuses the plan.
+    bool warm_start_duals;
+    int iterations;
+    const CancelToken *cancel;
+    // Whether solves wait for the other backends' MUMPS solves.
+    bool uses_mumps;
+    // Why Ipopt returned from the last solve.
+    Ipopt::ApplicationReturnStatus app_status;
+
+    // Set up once in the constructor, Solve only updates its parameters.
+    Ipopt::SmartPtr<MPCProblem<N> > nlp;
+    Ipopt::SmartPtr<Ipopt::IpoptApplication> app;
+};
+
+extern template class IpoptBackend<10>;
+extern template class IpoptBackend<15>;
+extern template class IpoptBackend<20>;
+extern template class IpoptBackend<128>;
+
+#endif /* IPOPT_BACKEND_H */
@@ -0,0 +1,189 @@
+#ifndef KINEMATIC_MODEL_H
+#define KINEMATIC_MODEL_H
+
+#include <cmath>
+#include "mpc_layout.h"
+
+// This value assumes the model presented in the classroom is used.
+//
+// It was obtained by measuring the radius formed by running the vehicle in the
+// simulator around in a circle with a constant steering angle and velocity on a
+// flat terrain.
+//
+// Lf was tuned until the the radius formed by the simulating the model
+// presented in the classroom matched the previous radius.
+//
+// This is the length from front to CoG that has a similar radius.
+const double Lf = 2.67;
+
+////////////////////////////////////////////////
+// Reference vars brought in from MPC quizzes //
+////////////////////////////////////////////////
+
+// Both the reference cross track and orientation errors are 0.
+const double ref_cte = 0;
+const double ref_epsi = 0;
+
+// The reference velocity; in MPH.
+const double ref_v = 16;
+
+// Cost weights. Emphasize keeping CTE and error-psi low!
+const double cte_weight = 2000;
+const double epsi_weight = 2000;
+const double v_weight = 1;
+// Minimize the use of actuators.
+const double delta_weight = 5;
+const double accel_weight = 5;
+// Minimize the value gap between sequential actuations.
+const double delta_change_weight = 200;
+const double accel_change_weight = 10;
+
+// The upper and lower limits of delta are set to -25 and 25
+// degrees (values in radians).
+// NOTE: Still not sure if *Lf should be included or not...
+const double max_delta = 0.436332 * Lf;
+// Acceleration/decceleration upper and lower limits.
+const double max_accel = 1.0;
+
+/**
+ * Advances the kinematic bicycle model by one timestep.
+ *
+ * The equations for the model, from lectures:
+ * x_[t+1] = x[t] + v[t] * cos(psi[t]) * dt
+ * y_[t+1] = y[t] + v[t] * sin(psi[t]) * dt
+ * psi_[t+1] = psi[t] + v[t] / Lf * delta[t] * dt
+ * v_[t+1] = v[t] + a[t] * dt
+ * cte[t+1] = f(x[t]) - y[t] + v[t] * sin(epsi[t]) * dt
+ * epsi[t+1] = psi[t] - psides[t] + v[t] * delta[t] / Lf * dt
+ *
+ * Templated on the scalar so the same equations are taped by FG_eval and
+ * evaluated in plain doubles by the other backends.
+ *
+ * @param next  receives x, y, psi, v, cte, epsi at t+1
+ * @param state  x, y, psi, v, cte, epsi at t
+ * @param delta  steering actuation at t
+ * @param a  acceleration actuation at t
+ * @param coeffs  the 4 coefficients of the fitted cubic
+ * @param dt  timestep duration, in seconds
+ */
+template <class Scalar, class Coeff>
+void kinematic_step(Scalar *next, const Scalar *state, const Scalar &delta,
+                    const Scalar &a, const Coeff *coeffs, double dt) {
+    using std::atan;
+    using std::cos;
+    using std::sin;
+
+    const Scalar &x0 = state[0];
+    const Scalar &y0 = state[1];
+    const Scalar &psi0 = state[2];
+    const Scalar &v0 = state[3];
+    const Scalar &epsi0 = state[5];
+
+    Scalar x0_squared = x0 * x0;
+    Scalar x0_cubed = x0_squared * x0;
+    Scalar f0 =  coeffs[0]     + coeffs[1] * x0 + coeffs[2] * x0_squared   + coeffs[3] * x0_cubed;
+    Scalar psides0 = atan(coeffs[1]      + 2 * coeffs[2] * x0       + 3 * coeffs[3] * x0_squared);
+
+    next[0] = x0 + v0 * cos(psi0) * dt;
+    next[1] = y0 + v0 * sin(psi0) * dt;
+    next[2] = psi0 + v0 * delta / Lf * dt;
+    next[3] = v0 + a * dt;
+    next[4] = (f0 - y0) + (v0 * sin(epsi0) * dt);
+    next[5] = (psi0 - psides0) + v0 * delta / Lf * dt;
+}
+
+/**
+ * Partial derivatives of kinematic_step with respect to the state and the
+ * actuations at t.
+ *
+ * @param jac  receives the 6 x 8 row-major Jacobian, rows are the next state
+ *             and columns are x, y, psi, v, cte, epsi, delta, a
+ */
+inline void kinematic_step_jacobian(double *jac, const double *state, double delta,
+                                    double a, const double *coeffs, double dt) {
+    const double x0 = state[0];
+    const double psi0 = state[2];
+    const double v0 = state[3];
+    const double epsi0 = state[5];
+
+    // f'(x) and f''(x) of the fitted cubic.
+    const double df0 = coeffs[1] + 2 * coeffs[2] * x0 + 3 * coeffs[3] * x0 * x0;
+    const double ddf0 = 2 * coeffs[2] + 6 * coeffs[3] * x0;
+
+    for (int i = 0; i < 6 * 8; ++i) {
+        jac[i] = 0.;
+    }
+    for (int i = 0; i < 6; ++i) {
+        jac[i * 8 + i] = 1.;
+    }
+    // The next cte and epsi do not carry the current ones over.
+    jac[4 * 8 + 4] = 0.;
+    jac[5 * 8 + 5] = 0.;
+
+    jac[0 * 8 + 2] = -v0 * sin(psi0) * dt;
+    jac[0 * 8 + 3] = cos(psi0) * dt;
+
+    jac[1 * 8 + 2] = v0 * cos(psi0) * dt;
+    jac[1 * 8 + 3] = sin(psi0) * dt;
+
+    jac[2 * 8 + 3] = delta / Lf * dt;
+    jac[2 * 8 + 6] = v0 / Lf * dt;
+
+    jac[3 * 8 + 7] = dt;
+
+    jac[4 * 8 + 0] = df0;
+    jac[4 * 8 + 1] = -1.;
+    jac[4 * 8 + 3] = sin(epsi0) * dt;
+    jac[4 * 8 + 5] = v0 * cos(epsi0) * dt;
+
+    jac[5 * 8 + 0] = -ddf0 / (1 + df0 * df0);
+    jac[5 * 8 + 2] = 1.;
+    jac[5 * 8 + 3] = delta / Lf * dt;
+    jac[5 * 8 + 6] = v0 / Lf * dt;
+}
+
+/**
+ * The terms of the MPC objective that belong to timestep t: the reference
+ * state errors at t, the actuations at t and their change to t + 1, where
+ * those exist.
+ */
+template <size_t N>
+double mpc_stage_cost(const double *vars, size_t t) {
+    typedef MPCLayout<N> Layout;
+
+    // The part of the cost based on the reference state.
+    const double cte = vars[Layout::cte_start + t] - ref_cte;
+    const double epsi = vars[Layout::epsi_start + t] - ref_epsi;
+    const double v = vars[Layout::v_start + t] - ref_v;
+    double cost = cte_weight * cte * cte + epsi_weight * epsi * epsi + v_weight * v * v;
+
+    // Minimize the use of actuators.
+    if (t < N - 1) {
+        const double delta = vars[Layout::delta_start + t];
+        const double a = vars[Layout::accel_start + t];
+        cost += delta_weight * delta * delta + accel_weight * a * a;
+    }
+
+    // Minimize the value gap between sequential actuations.
+    if (t < N - 2) {
+        const double ddelta = vars[Layout::delta_start + t + 1] - vars[Layout::delta_start + t];
+        const double da = vars[Layout::accel_start + t + 1] - vars[Layout::accel_start + t];
+        cost += delta_change_weight * ddelta * ddelta + accel_change_weight * da * da;
+    }
+    return cost;
+}
+
+/**
+ * The MPC objective, as taped by FG_eval, for a plan in the MPCLayout<N>
+ * variable layout.
+ */
+template <size_t N>
+double mpc_cost(const double *vars) {
+    double cost = 0;
+    for (size_t t = 0; t < N; ++t) {
+        cost += mpc_stage_cost<N>(vars, t);
+    }
+    return cost;
+}
+
+#endif /* KINEMATIC_MODEL_H */
@@ -0,0 +1,358 @@
+#include "kinematic_nlp.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "kinematic_model.h"
+#include "thread_pools.h"
+
+using Ipopt::Index;
+using Ipopt::Number;
+
+// Nonzero columns of each row of kinematic_step_jacobian, as indices into
+// x, y, psi, v, cte, epsi, delta, a (-1 pads the shorter rows).
+static const int step_jacobian_columns[n_state][4] = {
+        {0, 2, 3, -1},  // x
+        {1, 2, 3, -1},  // y
+        {2, 3, 6, -1},  // psi
+        {3, 7, -1, -1}, // v
+        {0, 1, 3, 5},   // cte
+        {0, 2, 3, 6}    // epsi
+};
+
+// Horizons this long and longer are evaluated in chunks of about
+// steps_per_chunk dynamics steps each; shorter ones are not worth the handoff.
+static const size_t min_parallel_horizon = 64;
+static const size_t steps_per_chunk = 32;
+
+template <size_t N> constexpr size_t KinematicNLP<N>::nnz_jac_step;
+template <size_t N> constexpr size_t KinematicNLP<N>::nnz_jac;
+template <size_t N> constexpr size_t KinematicNLP<N>::n_hes_step_terms;
+template <size_t N> constexpr size_t KinematicNLP<N>::n_hes_dynamics_terms;
+template <size_t N> constexpr size_t KinematicNLP<N>::n_hes_terms;
+
+template <size_t N>
+KinematicNLP<N>::KinematicNLP(double dt, bool parallel)
+        : dt(dt), params(), hes_dynamics_terms() {
+    chunks = parallel && N >= min_parallel_horizon ? (N - 1) / steps_per_chunk : 1;
+    chunk_costs.resize(chunks);
+
+    // Number the distinct Hessian entries once, in the order they first show up.
+    std::map<std::pair<size_t, size_t>, size_t> entries;
+    size_t term = 0;
+    auto assign_slot = [&](size_t row, size_t col, double) {
+        auto inserted = entries.insert(std::make_pair(std::make_pair(row, col), entries.size()));
+        const size_t slot = inserted.first->second;
+        if (inserted.second) {
+            hes_row[slot] = row;
+            hes_col[slot] = col;
+        }
+        hes_slots[term++] = slot;
+    };
+    std::array<double, Layout::n_vars> x = {};
+    std::array<double, Layout::n_constraints> lambda = {};
+    VisitHessian(x.data(), 1., lambda.data(), assign_slot);
+    nnz_hes = entries.size();
+}
+
+template <size_t N>
+KinematicNLP<N>::~KinematicNLP() {}
+
+template <size_t N>
+void KinematicNLP<N>::SetParameters(const ParamVector &params) {
+    this->params = params;
+}
+
+template <size_t N>
+size_t KinematicNLP<N>::VarIndex(size_t c, size_t t) {
+    if (c < n_state) {
+        return Layout::x_start + c * N + t;
+    }
+    return (c == n_state ? Layout::delta_start : Layout::accel_start) + t;
+}
+
+template <size_t N>
+template <class Body>
+void KinematicNLP<N>::ForEachChunk(size_t count, const Body &body) const {
+    if (chunks == 1) {
+        body(0, 0, count);
+    } else {
+        ParallelFor(count, chunks, body);
+    }
+}
+
+template <size_t N>
+bool KinematicNLP<N>::get_nlp_info(Index &n, Index &m, Index &nnz_jac_g,
+                                   Index &nnz_h_lag, Ipopt::TNLP::IndexStyleEnum &index_style) {
+    n = Layout::n_vars;
+    m = Layout::n_constraints;
+    nnz_jac_g = nnz_jac;
+    nnz_h_lag = nnz_hes;
+    index_style = Ipopt::TNLP::C_STYLE;
+    return true;
+}
+
+template <size_t N>
+bool KinematicNLP<N>::eval_f(Index n, const Number *x, bool new_x, Number &obj_value) {
+    ForEachChunk(N, [&](size_t chunk, size_t begin, size_t end) {
+        double cost = 0;
+        for (size_t t = begin; t < end; ++t) {
+            cost += mpc_stage_cost<N>(x, t);
+        }
+        chunk_costs[chunk] = cost;
+    });
+
+    // In chunk order, so the sum does not depend on which chunk ends first.
+    obj_value = 0;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        obj_value += chunk_costs[chunk];
+    }
+    return true;
+}
+
+template <size_t N>
+bool KinematicNLP<N>::eval_grad_f(Index n, const Number *x, bool new_x, Number *grad_f) {
+    std::fill(grad_f, grad_f + n, 0.);
+
+    for (size_t t = 0; t < N; ++t) {
+        grad_f[Layout::cte_start + t] = 2 * cte_weight * (x[Layout::cte_start + t] - ref_cte);
+        grad_f[Layout::epsi_start + t] = 2 * epsi_weight * (x[Layout::epsi_start + t] - ref_epsi);
+        grad_f[Layout::v_start + t] = 2 * v_weight * (x[Layout::v_start + t] - ref_v);
+    }
+
+    for (size_t t = 0; t < N - 1; ++t) {
+        grad_f[Layout::delta_start + t] = 2 * delta_weight * x[Layout::delta_start + t];
+        grad_f[Layout::accel_start + t] = 2 * accel_weight * x[Layout::accel_start + t];
+    }
+
+    for (size_t t = 0; t < N - 2; ++t) {
+        const double ddelta = x[Layout::delta_start + t + 1] - x[Layout::delta_start + t];
+        const double da = x[Layout::accel_start + t + 1] - x[Layout::accel_start + t];
+        grad_f[Layout::delta_start + t + 1] += 2 * delta_change_weight * ddelta;
+        grad_f[Layout::delta_start + t] -= 2 * delta_change_weight * ddelta;
+        grad_f[Layout::accel_start + t + 1] += 2 * accel_change_weight * da;
+        grad_f[Layout::accel_start + t] -= 2 * accel_change_weight * da;
+    }
+    return true;
+}
+
+template <size_t N>
+bool KinematicNLP<N>::eval_g(Index n, const Number *x, bool new_x, Index m, Number *g) {
+    const double *coeffs = &params[n_state];
+
+    // Initial constraints, pinned to the state parameters.
+    for (size_t i = 0; i < n_state; ++i) {
+        g[Layout::x_start + i * N] = x[Layout::x_start + i * N] - params[i];
+    }
+
+    // The rest of the constraints, over time
+    ForEachChunk(N - 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t t = begin + 1; t < end + 1; ++t) {
+            double state0[n_state];
+            double state1[n_state];
+            for (size_t i = 0; i < n_state; ++i) {
+                state0[i] = x[Layout::x_start + i * N + t - 1];
+            }
+            kinematic_step(state1, state0, x[Layout::delta_start + t - 1],
+                           x[Layout::accel_start + t - 1], coeffs, dt);
+            for (size_t i = 0; i < n_state; ++i) {
+                g[Layout::x_start + i * N + t] = x[Layout::x_start + i * N + t] - state1[i];
+            }
+        }
+    });
+    return true;
+}
+
+template <size_t N>
+bool KinematicNLP<N>::eval_jac_g(Index n, const Number *x, bool new_x,
+                                 Index m, Index nele_jac, Index *iRow,
+                                 Index *jCol, Number *values) {
+    const double *coeffs = &params[n_state];
+
+    // Initial constraints.
+    for (size_t i = 0; i < n_state; ++i) {
+        if (values == NULL) {
+            iRow[i] = Layout::x_start + i * N;
+            jCol[i] = Layout::x_start + i * N;
+        } else {
+            values[i] = 1.;
+        }
+    }
+
+    // Each dynamics row is +1 on the next state and minus the step Jacobian on
+    // the current state and actuations. Every step has the same number of
+    // entries, so each chunk knows where its entries start.
+    auto steps = [&](size_t, size_t begin, size_t end) {
+        size_t k = n_state + begin * nnz_jac_step;
+        for (size_t t = begin + 1; t < end + 1; ++t) {
+            double jac[n_state * 8];
+            if (values != NULL) {
+                double state0[n_state];
+                for (size_t i = 0; i < n_state; ++i) {
+                    state0[i] = x[Layout::x_start + i * N + t - 1];
+                }
+                kinematic_step_jacobian(jac, state0, x[Layout::delta_start + t - 1],
+                                        x[Layout::accel_start + t - 1], coeffs, dt);
+            }
+
+            for (size_t i = 0; i < n_state; ++i) {
+                const size_t row = Layout::x_start + i * N + t;
+                if (values == NULL) {
+                    iRow[k] = row;
+                    jCol[k] = row;
+                } else {
+                    values[k] = 1.;
+                }
+                ++k;
+
+                for (size_t j = 0; j < 4 && step_jacobian_columns[i][j] >= 0; ++j, ++k) {
+                    const size_t c = step_jacobian_columns[i][j];
+                    if (values == NULL) {
+                        iRow[k] = row;
+                        jCol[k] = VarIndex(c, t - 1);
+                    } else {
+                        values[k] = -jac[i * 8 + c];
+                    }
+                }
+            }
+        }
+    };
+    // The structure is only asked for once.
+    if (values == NULL) {
+        steps(0, 0, N - 1);
+    } else {
+        ForEachChunk(N - 1, steps);
+    }
+    return true;
+}
+
+template <size_t N>
+template <class Sink>
+void KinematicNLP<N>::VisitStepHessian(const Number *x, const Number *lambda, size_t t,
+                                       Sink &sink) const {
+    const double *coeffs = &params[n_state];
+
+    const size_t ix = Layout::x_start + t - 1;
+    const size_t ipsi = Layout::psi_start + t - 1;
+    const size_t iv = Layout::v_start + t - 1;
+    const size_t iepsi = Layout::epsi_start + t - 1;
+    const size_t idelta = Layout::delta_start + t - 1;
+
+    const double x0 = x[ix];
+    const double psi0 = x[ipsi];
+    const double v0 = x[iv];
+    const double epsi0 = x[iepsi];
+
+    const double lx = lambda[Layout::x_start + t];
+    const double ly = lambda[Layout::y_start + t];
+    const double lpsi = lambda[Layout::psi_start + t];
+    const double lcte = lambda[Layout::cte_start + t];
+    const double lepsi = lambda[Layout::epsi_start + t];
+
+    // f'(x), f''(x) and f'''(x) of the fitted cubic.
+    const double df0 = coeffs[1] + 2 * coeffs[2] * x0 + 3 * coeffs[3] * x0 * x0;
+    const double ddf0 = 2 * coeffs[2] + 6 * coeffs[3] * x0;
+    const double dddf0 = 6 * coeffs[3];
+    const double q = 1 + df0 * df0;
+    // Second derivative of atan(f'(x)).
+    const double datan2 = dddf0 / q - 2 * df0 * ddf0 * ddf0 / (q * q);
+
+    // x: v cos(psi)
+    sink(ipsi, ipsi, lx * v0 * cos(psi0) * dt);
+    sink(iv, ipsi, lx * sin(psi0) * dt);
+    // y: v sin(psi)
+    sink(ipsi, ipsi, ly * v0 * sin(psi0) * dt);
+    sink(iv, ipsi, -ly * cos(psi0) * dt);
+    // psi: v delta / Lf
+    sink(idelta, iv, -lpsi * dt / Lf);
+    // cte: f(x) + v sin(epsi)
+    sink(ix, ix, -lcte * ddf0);
+    sink(iepsi, iv, -lcte * cos(epsi0) * dt);
+    sink(iepsi, iepsi, lcte * v0 * sin(epsi0) * dt);
+    // epsi: -atan(f'(x)) + v delta / Lf
+    sink(ix, ix, lepsi * datan2);
+    sink(idelta, iv, -lepsi * dt / Lf);
+}
+
+template <size_t N>
+template <class Sink>
+void KinematicNLP<N>::VisitHessian(const Number *x, Number obj_factor,
+                                   const Number *lambda, Sink &sink) const {
+    // Dynamics. The constraints are next - f(current), so each contributes
+    // -lambda times the second derivatives of kinematic_step.
+    for (size_t t = 1; t < N; ++t) {
+        VisitStepHessian(x, lambda, t, sink);
+    }
+    VisitCostHessian(obj_factor, sink);
+}
+
+template <size_t N>
+template <class Sink>
+void KinematicNLP<N>::VisitCostHessian(Number obj_factor, Sink &sink) const {
+    // The cost is a sum of squares.
+    for (size_t t = 0; t < N; ++t) {
+        sink(Layout::cte_start + t, Layout::cte_start + t, obj_factor * 2 * cte_weight);
+        sink(Layout::epsi_start + t, Layout::epsi_start + t, obj_factor * 2 * epsi_weight);
+        sink(Layout::v_start + t, Layout::v_start + t, obj_factor * 2 * v_weight);
+    }
+
+    for (size_t t = 0; t < N - 1; ++t) {
+        sink(Layout::delta_start + t, Layout::delta_start + t, obj_factor * 2 * delta_weight);
+        sink(Layout::accel_start + t, Layout::accel_start + t, obj_factor * 2 * accel_weight);
+    }
+
+    for (size_t t = 0; t < N - 2; ++t) {
+        const size_t d0 = Layout::delta_start + t;
+        const size_t a0 = Layout::accel_start + t;
+        sink(d0, d0, obj_factor * 2 * delta_change_weight);
+        sink(d0 + 1, d0 + 1, obj_factor * 2 * delta_change_weight);
+        sink(d0 + 1, d0, -obj_factor * 2 * delta_change_weight);
+        sink(a0, a0, obj_factor * 2 * accel_change_weight);
+        sink(a0 + 1, a0 + 1, obj_factor * 2 * accel_change_weight);
+        sink(a0 + 1, a0, -obj_factor * 2 * accel_change_weight);
+    }
+}
+
+template <size_t N>
+bool KinematicNLP<N>::eval_h(Index n, const Number *x, bool new_x,
+                             Number obj_factor, Index m, const Number *lambda,
+                             bool new_lambda, Index nele_hess, Index *iRow,
+                             Index *jCol, Number *values) {
+    if (values == NULL) {
+        for (size_t k = 0; k < nnz_hes; ++k) {
+            iRow[k] = hes_row[k];
+            jCol[k] = hes_col[k];
+        }
+        return true;
+    }
+
+    std::fill(values, values + nnz_hes, 0.);
+    size_t term = 0;
+    auto accumulate = [&](size_t, size_t, double value) {
+        values[hes_slots[term++]] += value;
+    };
+    if (chunks == 1) {
+        VisitHessian(x, obj_factor, lambda, accumulate);
+        return true;
+    }
+
+    // The dynamics terms in parallel, each step into its own place, then all
+    // the terms accumulated in the same order as serially.
+    ForEachChunk(N - 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t t = begin + 1; t < end + 1; ++t) {
+            double *step_terms = &hes_dynamics_terms[(t - 1) * n_hes_step_terms];
+            auto store = [&](size_t, size_t, double value) { *step_terms++ = value; };
+            VisitStepHessian(x, lambda, t, store);
+        }
+    });
+    for (; term < n_hes_dynamics_terms; ++term) {
+        values[hes_slots[term]] += hes_dynamics_terms[term];
+    }
+    VisitCostHessian(obj_factor, accumulate);
+    return true;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class KinematicNLP<10>;
+template class KinematicNLP<15>;
+template class KinematicNLP<20>;
+template class KinematicNLP<128>;
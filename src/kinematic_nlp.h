@@ -0,0 +1,130 @@
+#ifndef KINEMATIC_NLP_H
+#define KINEMATIC_NLP_H
+
+#include <array>
+#include <vector>
+#include "mpc_problem.h"
+
+/**
+ * Ipopt problem for the kinematic bicycle model with hand-written derivatives.
+ *
+ * Same objective and constraints as FG_eval, but the block-banded Jacobian and
+ * the Lagrangian Hessian are written out analytically, one timestep at a time,
+ * instead of being swept out of a CppAD tape.
+ *
+ * Each dynamics block only involves two adjacent timesteps, so for horizons
+ * of 64 steps and more the blocks are evaluated in chunks on the compute
+ * workers (see ParallelFor). The chunks only depend on N, whatever the number
+ * of cores, and their results are combined in chunk order, so every
+ * evaluation is deterministic.
+ */
+template <size_t N>
+class KinematicNLP : public MPCProblem<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename MPCProblem<N>::ParamVector ParamVector;
+
+    /**
+     * @param dt  timestep duration, in seconds
+     * @param parallel  whether long horizons are evaluated in chunks; false
+     *                  evaluates every horizon serially
+     */
+    explicit KinematicNLP(double dt, bool parallel = true);
+
+    virtual ~KinematicNLP();
+
+    void SetParameters(const ParamVector &params) override;
+
+    bool get_nlp_info(Ipopt::Index &n, Ipopt::Index &m, Ipopt::Index &nnz_jac_g,
+                      Ipopt::Index &nnz_h_lag, Ipopt::TNLP::IndexStyleEnum &index_style) override;
+
+    bool eval_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Number &obj_value) override;
+
+    bool eval_grad_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                     Ipopt::Number *grad_f) override;
+
+    bool eval_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Index m, Ipopt::Number *g) override;
+
+    bool eval_jac_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                    Ipopt::Index m, Ipopt::Index nele_jac, Ipopt::Index *iRow,
+                    Ipopt::Index *jCol, Ipopt::Number *values) override;
+
+    bool eval_h(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Number obj_factor, Ipopt::Index m, const Ipopt::Number *lambda,
+                bool new_lambda, Ipopt::Index nele_hess, Ipopt::Index *iRow,
+                Ipopt::Index *jCol, Ipopt::Number *values) override;
+
+private:
+    // Jacobian entries of one dynamics step: 4 for x, y and psi, 3 for v and
+    // 5 for cte and epsi, each including the +1 on the next state.
+    static constexpr size_t nnz_jac_step = 25;
+    static constexpr size_t nnz_jac = n_state + (N - 1) * nnz_jac_step;
+
+    // Every Hessian contribution made by VisitHessian: 10 per dynamics step,
+    // 3 per state, 2 per actuation and 6 per pair of sequential actuations.
+    // Several land on the same entry.
+    static constexpr size_t n_hes_step_terms = 10;
+    static constexpr size_t n_hes_dynamics_terms = n_hes_step_terms * (N - 1);
+    static constexpr size_t n_hes_terms = n_hes_dynamics_terms + 3 * N + 2 * (N - 1) + 6 * (N - 2);
+
+    /**
+     * Calls sink(row, col, value) for every term of the lower triangle of
+     * the Lagrangian Hessian, always in the same order: the dynamics steps
+     * first, then the cost.
+     */
+    template <class Sink>
+    void VisitHessian(const Ipopt::Number *x, Ipopt::Number obj_factor,
+                      const Ipopt::Number *lambda, Sink &sink) const;
+
+    /**
+     * Calls sink(row, col, value) for the n_hes_step_terms Hessian terms of
+     * the dynamics block from timestep t - 1 to t.
+     */
+    template <class Sink>
+    void VisitStepHessian(const Ipopt::Number *x, const Ipopt::Number *lambda, size_t t,
+                          Sink &sink) const;
+
+    /**
+     * Calls sink(row, col, value) for the Hessian terms of the cost, scaled
+     * by obj_factor.
+     */
+    template <class Sink>
+    void VisitCostHessian(Ipopt::Number obj_factor, Sink &sink) const;
+
+    /**
+     * Calls body(chunk, begin, end) over chunks of [0, count), in parallel
+     * if the horizon is long enough to be split.
+     */
+    template <class Body>
+    void ForEachChunk(size_t count, const Body &body) const;
+
+    // Index of column c of kinematic_step_jacobian at timestep t.
+    static size_t VarIndex(size_t c, size_t t);
+
+    const double dt;
+    ParamVector params;
+
+    // Number of chunks the timesteps are split into, 1 to evaluate serially.
+    size_t chunks;
+    // The cost of each chunk's timesteps, summed in order by eval_f.
+    std::vector<double> chunk_costs;
+    // The dynamics terms of the Hessian, filled in parallel and then
+    // accumulated in order by eval_h.
+    std::array<double, n_hes_dynamics_terms> hes_dynamics_terms;
+
+    // Hessian entry each term of VisitHessian accumulates into, and the
+    // structure of those entries.
+    std::array<size_t, n_hes_terms> hes_slots;
+    std::array<size_t, n_hes_terms> hes_row;
+    std::array<size_t, n_hes_terms> hes_col;
+    size_t nnz_hes;
+};
+
+extern template class KinematicNLP<10>;
+extern template class KinematicNLP<15>;
+extern template class KinematicNLP<20>;
+extern template class KinematicNLP<128>;
+
+#endif /* KINEMATIC_NLP_H */
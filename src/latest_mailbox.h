@@ -0,0 +1,72 @@
+#ifndef LATEST_MAILBOX_H
+#define LATEST_MAILBOX_H
+
+#include <atomic>
+
+/**
+ * Single-slot mailbox between one producer and one consumer thread, where a
+ * newer value replaces one that has not been taken yet.
+ *
+ * It is a triple buffer: the producer fills its back buffer in place and
+ * publishes it by swapping it with the middle one, and the consumer takes the
+ * middle one by swapping it with its front buffer. Both sides are wait-free
+ * and values are never copied.
+ */
+template <class T>
+class LatestMailbox {
+public:
+    explicit LatestMailbox(const T &initial = T())
+            : buffers{initial, initial, initial}, back(0), middle(1), front(2) {}
+
+    /**
+     * @return the producer's buffer, to fill before Publish
+     */
+    T &Back() { return buffers[back]; }
+
+    /**
+     * Makes the back buffer the latest value.
+     * @return false if this replaced a value that was never taken
+     */
+    bool Publish() {
+        const unsigned previous = middle.exchange(back | fresh, std::memory_order_acq_rel);
+        back = previous & ~fresh;
+        return !(previous & fresh);
+    }
+
+    /**
+     * Takes the latest value into Front, if one was published since the last
+     * Take.
+     * @return whether there was a new value
+     */
+    bool Take() {
+        if (!(middle.load(std::memory_order_acquire) & fresh)) {
+            return false;
+        }
+        const unsigned previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & ~fresh;
+        return true;
+    }
+
+    /**
+     * @return whether a value was published and not taken yet
+     */
+    bool HasNew() const { return middle.load(std::memory_order_acquire) & fresh; }
+
+    /**
+     * @return the consumer's buffer, holding the last value taken
+     */
+    T &Front() { return buffers[front]; }
+
+private:
+    // Set in middle when it holds a value not taken yet.
+    static const unsigned fresh = 4;
+
+    T buffers[3];
+    // Owned by the producer.
+    unsigned back;
+    std::atomic<unsigned> middle;
+    // Owned by the consumer.
+    unsigned front;
+};
+
+#endif /* LATEST_MAILBOX_H */
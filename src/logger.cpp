@@ -0,0 +1,174 @@
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Ring buffer capacity, a power of two, and the longest message kept. Raw
+// telemetry messages are about 1 kB.
+const size_t log_slots = 1024;
+const size_t log_slot_size = 2048;
+
+// How long the writer sleeps when there is nothing to write.
+const std::chrono::milliseconds idle_wait(1);
+
+/**
+ * Bounded multi-producer, single-consumer queue of formatted messages,
+ * after Vyukov's bounded MPMC queue: each slot's sequence number tells
+ * whether it is free for the producer at that position or ready for the
+ * consumer, so neither side takes a lock.
+ */
+class AsyncLogger {
+public:
+    AsyncLogger()
+            : level(LOG_DEBUG), telemetry_every(1), telemetry_count(0),
+              slots(new Slot[log_slots]), tail(0), head(0), dropped(0), running(true) {
+        for (size_t i = 0; i < log_slots; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        writer = std::thread(&AsyncLogger::Write, this);
+    }
+
+    // Writes out whatever is left, at exit.
+    ~AsyncLogger() {
+        running.store(false, std::memory_order_release);
+        writer.join();
+    }
+
+    void Push(const char *format, va_list args) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots[pos & (log_slots - 1)];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = (std::ptrdiff_t) sequence - (std::ptrdiff_t) pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full, the writer is behind.
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        const int length = vsnprintf(slot->text, log_slot_size, format, args);
+        slot->length = length < 0 ? 0 : std::min((size_t) length, log_slot_size - 1);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // Settings, read by every producer.
+    std::atomic<int> level;
+    std::atomic<unsigned> telemetry_every;
+    std::atomic<unsigned> telemetry_count;
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        size_t length;
+        char text[log_slot_size];
+    };
+
+    // Body of the writer thread.
+    void Write() {
+        for (;;) {
+            // Read before draining, so nothing logged before shutdown is lost.
+            const bool stopping = !running.load(std::memory_order_acquire);
+            bool wrote = false;
+            for (;;) {
+                Slot &slot = slots[head & (log_slots - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                    break;
+                }
+                fwrite(slot.text, 1, slot.length, stdout);
+                fputc('\n', stdout);
+                slot.sequence.store(head + log_slots, std::memory_order_release);
+                ++head;
+                wrote = true;
+            }
+
+            const size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost > 0) {
+                fprintf(stdout, "WARN: Log buffer full, dropped %zu messages!\n", lost);
+                wrote = true;
+            }
+            if (wrote) {
+                fflush(stdout);
+            }
+            if (stopping) {
+                return;
+            }
+            if (!wrote) {
+                std::this_thread::sleep_for(idle_wait);
+            }
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    // Next position to claim, shared by the producers.
+    std::atomic<size_t> tail;
+    // Next position to write, owned by the writer thread.
+    size_t head;
+    std::atomic<size_t> dropped;
+    std::atomic<bool> running;
+    std::thread writer;
+};
+
+// Started on first use, and flushed and stopped at exit.
+AsyncLogger &Logger() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+} // namespace
+
+bool ParseLogLevel(const char *name, LogLevel &level) {
+    static const char *const names[] = {"debug", "info", "warn", "error"};
+    for (int i = LOG_DEBUG; i <= LOG_ERROR; ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            level = (LogLevel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SetLogLevel(LogLevel level) {
+    Logger().level.store(level, std::memory_order_relaxed);
+}
+
+bool LogEnabled(LogLevel level) {
+    return level >= Logger().level.load(std::memory_order_relaxed);
+}
+
+void Log(LogLevel level, const char *format, ...) {
+    if (!LogEnabled(level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    Logger().Push(format, args);
+    va_end(args);
+}
+
+void SetTelemetryLogSampling(unsigned every) {
+    Logger().telemetry_every.store(every, std::memory_order_relaxed);
+}
+
+bool SampleTelemetryLog() {
+    AsyncLogger &logger = Logger();
+    const unsigned every = logger.telemetry_every.load(std::memory_order_relaxed);
+    if (every == 0 || !LogEnabled(LOG_DEBUG)) {
+        return false;
+    }
+    return logger.telemetry_count.fetch_add(1, std::memory_order_relaxed) % every == 0;
+}
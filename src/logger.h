@@ -0,0 +1,54 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstddef>
+
+// How much a log message matters, least first.
+enum LogLevel {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR
+};
+
+/**
+ * Parses a level name: debug, info, warn or error.
+ * @return false if the name is not one of them
+ */
+bool ParseLogLevel(const char *name, LogLevel &level);
+
+/**
+ * Messages below this level are dropped before they are formatted. Defaults
+ * to LOG_DEBUG, which keeps everything.
+ */
+void SetLogLevel(LogLevel level);
+
+/**
+ * @return whether a message at this level would be logged
+ */
+bool LogEnabled(LogLevel level);
+
+/**
+ * Logs a printf-style message.
+ *
+ * The message is formatted into a preallocated slot of a lock-free ring
+ * buffer and written to stdout by a background thread, so that callers never
+ * wait on the console. Safe to call from any thread. Messages longer than a
+ * slot are truncated, and messages logged while the buffer is full are
+ * dropped and counted.
+ */
+void Log(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Raw telemetry and steer messages are dumped for 1 in every `every` ticks
+ * only, or never for 0. Defaults to every tick.
+ */
+void SetTelemetryLogSampling(unsigned every);
+
+/**
+ * Counts a tick towards the telemetry sampling.
+ * @return whether this tick's raw messages are to be dumped
+ */
+bool SampleTelemetryLog();
+
+#endif /* LOGGER_H */
@@ -0,0 +1,189 @@
+#include "ltv_mpc.h"
+#include <algorithm>
+#include <cmath>
+#include "Eigen-3.3/Eigen/LU"
+#include "kinematic_model.h"
+
+// Centering: each Newton step targets this fraction of the current duality gap.
+static const double centering = 0.1;
+// Fraction to the boundary kept by every step.
+static const double step_to_boundary = 0.995;
+static const double duality_gap_tolerance = 1e-8;
+static const double step_tolerance = 1e-8;
+static const int max_iterations = 50;
+
+template <size_t N> constexpr int LTVMPC<N>::nu;
+template <size_t N> constexpr int LTVMPC<N>::nc;
+
+template <size_t N>
+LTVMPC<N>::LTVMPC(double dt) : obj_value(0.), iterations(0), dt(dt), has_plan(false) {
+    solution_x.fill(0.);
+
+    h << M::MaxActuation(), M::MaxActuation();
+
+    for (size_t t = 0; t < N - 1; ++t) {
+        u_plan[t] = UVector::Zero();
+        M::InitLinearization(A[t], B[t]);
+    }
+}
+
+template <size_t N>
+void LTVMPC<N>::Reset() {
+    has_plan = false;
+}
+
+template <size_t N>
+void LTVMPC<N>::Rollout(const StateVector &state, const CoeffVector &coeffs) {
+    z_nominal[0].template head<n_state>() = state.head<n_state>();
+    z_nominal[0].template tail<nu>().setZero();
+
+    for (size_t t = 0; t < N - 1; ++t) {
+        M::Step(z_nominal[t + 1], z_nominal[t], u_plan[t], coeffs.data(), dt);
+    }
+}
+
+template <size_t N>
+void LTVMPC<N>::BackwardPass(double sigma_mu) {
+    const std::array<ZZMatrix, N> &Q = cost.Q;
+    const std::array<UUMatrix, N - 1> &R = cost.R;
+    const std::array<UZMatrix, N - 1> &S = cost.S;
+
+    ZZMatrix P = Q[N - 1];
+    ZVector p = Q[N - 1] * z[N - 1] + cost.q_ref;
+
+    for (size_t i = N - 1; i-- > 0;) {
+        // Gradient of the cost at the current iterate.
+        ZVector gz = Q[i] * z[i] + cost.q_ref + S[i].transpose() * u[i];
+        UVector gu = R[i] * u[i] + S[i] * z[i];
+
+        // The log barrier on the actuator bounds, with the primal-dual
+        // (rather than primal) Hessian.
+        UUMatrix Ri = R[i];
+        for (int j = 0; j < nu; ++j) {
+            Ri(j, j) += dual[i](j) / slack[i](j) + dual[i](j + nu) / slack[i](j + nu);
+            gu(j) += sigma_mu / slack[i](j) - sigma_mu / slack[i](j + nu);
+        }
+
+        const ZZMatrix PA = P * A[i];
+        const ZUMatrix PB = P * B[i];
+        const ZZMatrix Qzz = Q[i] + A[i].transpose() * PA;
+        const UUMatrix Quu = Ri + B[i].transpose() * PB;
+        const UZMatrix Quz = S[i] + B[i].transpose() * PA;
+        const ZVector qz = gz + A[i].transpose() * p;
+        const UVector qu = gu + B[i].transpose() * p;
+
+        const UUMatrix Quu_inv = Quu.inverse();
+        K[i] = -Quu_inv * Quz;
+        k[i] = -Quu_inv * qu;
+
+        P = Qzz + Quz.transpose() * K[i];
+        P = 0.5 * (P + P.transpose()).eval();
+        p = qz + Quz.transpose() * k[i];
+    }
+}
+
+template <size_t N>
+void LTVMPC<N>::ForwardPass() {
+    // The initial state is fixed.
+    dz[0].setZero();
+    for (size_t t = 0; t < N - 1; ++t) {
+        du[t] = K[t] * dz[t] + k[t];
+        dz[t + 1] = A[t] * dz[t] + B[t] * du[t];
+    }
+}
+
+template <size_t N>
+SolveStatus LTVMPC<N>::Solve(const StateVector &state, const CoeffVector &coeffs,
+                             std::chrono::steady_clock::time_point deadline) {
+    // Linearize around the previous plan moved one step forward in time, or
+    // around zero actuations if there is none. The barrier needs a strictly
+    // interior starting point.
+    if (has_plan) {
+        std::rotate(u_plan.begin(), u_plan.begin() + 1, u_plan.end());
+        u_plan[N - 2] = u_plan[N - 3];
+    } else {
+        for (size_t t = 0; t < N - 1; ++t) {
+            u_plan[t].setZero();
+        }
+    }
+    for (size_t t = 0; t < N - 1; ++t) {
+        u_plan[t] = u_plan[t].cwiseMax(-0.99 * h.template head<nu>())
+                             .cwiseMin(0.99 * h.template head<nu>());
+    }
+
+    Rollout(state, coeffs);
+    for (size_t t = 0; t < N - 1; ++t) {
+        M::Linearize(A[t], B[t], z_nominal[t], u_plan[t], coeffs.data(), dt);
+    }
+
+    for (size_t t = 0; t < N; ++t) {
+        z[t] = z_nominal[t];
+    }
+    for (size_t t = 0; t < N - 1; ++t) {
+        u[t] = u_plan[t];
+        slack[t] << h.template head<nu>() - u[t], h.template tail<nu>() + u[t];
+        dual[t].setOnes();
+    }
+
+    bool converged = false;
+    for (iterations = 0; iterations < max_iterations && !converged; ++iterations) {
+        double gap = 0;
+        for (size_t t = 0; t < N - 1; ++t) {
+            gap += slack[t].dot(dual[t]);
+        }
+        const double sigma_mu = centering * gap / (nc * (N - 1));
+
+        BackwardPass(sigma_mu);
+        ForwardPass();
+
+        // Recover the slack and dual steps, and take the longest step that
+        // keeps both positive.
+        double alpha = 1.;
+        for (size_t t = 0; t < N - 1; ++t) {
+            CVector G_du;
+            G_du << du[t], -du[t];
+            dslack[t] = -G_du;
+            ddual[t] = dual[t].cwiseQuotient(slack[t]).cwiseProduct(G_du) - dual[t]
+                       + sigma_mu * slack[t].cwiseInverse();
+            for (int j = 0; j < nc; ++j) {
+                if (dslack[t](j) < 0) {
+                    alpha = std::min(alpha, -step_to_boundary * slack[t](j) / dslack[t](j));
+                }
+                if (ddual[t](j) < 0) {
+                    alpha = std::min(alpha, -step_to_boundary * dual[t](j) / ddual[t](j));
+                }
+            }
+        }
+
+        double max_step = 0;
+        gap = 0;
+        for (size_t t = 0; t < N - 1; ++t) {
+            u[t] += alpha * du[t];
+            slack[t] += alpha * dslack[t];
+            dual[t] += alpha * ddual[t];
+            max_step = std::max(max_step, alpha * du[t].cwiseAbs().maxCoeff());
+            gap += slack[t].dot(dual[t]);
+        }
+        for (size_t t = 0; t < N; ++t) {
+            z[t] += alpha * dz[t];
+        }
+
+        converged = gap < duality_gap_tolerance && max_step < step_tolerance;
+    }
+
+    // Report the plan as the nonlinear model plays it out.
+    for (size_t t = 0; t < N - 1; ++t) {
+        u_plan[t] = u[t];
+    }
+    Rollout(state, coeffs);
+    obj_value = augmented_to_vars<N>(solution_x, z_nominal, u_plan);
+
+    has_plan = converged;
+    return converged ? SOLVE_CONVERGED : SOLVE_FAILED;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class LTVMPC<10>;
+template class LTVMPC<15>;
+template class LTVMPC<20>;
+template class LTVMPC<128>;
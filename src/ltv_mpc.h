@@ -0,0 +1,120 @@
+#ifndef LTV_MPC_H
+#define LTV_MPC_H
+
+#include <array>
+#include "Eigen-3.3/Eigen/Core"
+#include "augmented_model.h"
+#include "mpc_layout.h"
+#include "solver_backend.h"
+
+/**
+ * Linear time-varying MPC for the kinematic model.
+ *
+ * The dynamics are linearized once per solve around the previous plan (shifted
+ * by one step), and the resulting box-constrained QP is solved with a
+ * primal-dual interior point method whose Newton steps are computed by a
+ * Riccati recursion over the horizon, so the cost grows linearly in N and
+ * nothing is allocated per solve.
+ *
+ * The QP works on the AugmentedModel, so the actuation smoothing terms are
+ * stage-wise.
+ */
+template <size_t N>
+class LTVMPC : public SolverBackend<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename SolverBackend<N>::VarVector VarVector;
+
+    typedef AugmentedModel M;
+    static constexpr int nu = M::nu;
+    // Box constraints: u <= u_max, then -u <= u_max.
+    static constexpr int nc = 2 * M::nu;
+
+    typedef M::ZVector ZVector;
+    typedef M::UVector UVector;
+    typedef Eigen::Matrix<double, nc, 1> CVector;
+    typedef M::ZZMatrix ZZMatrix;
+    typedef M::ZUMatrix ZUMatrix;
+    typedef M::UZMatrix UZMatrix;
+    typedef M::UUMatrix UUMatrix;
+
+    /**
+     * @param dt  timestep duration, in seconds
+     */
+    explicit LTVMPC(double dt);
+
+    /**
+     * Solves the QP linearized around the previous plan. The interior point
+     * iterations are bounded, so the deadline is not checked.
+     * @param state  x, y, psi, v, cte, epsi
+     * @param coeffs  the fitted polynomial
+     * @return SOLVE_CONVERGED if the interior point iterations converged
+     */
+    SolveStatus Solve(const StateVector &state, const CoeffVector &coeffs,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+    const VarVector &Solution() const override { return solution_x; }
+
+    double Cost() const override { return obj_value; }
+
+    int Iterations() const override { return iterations; }
+
+    /**
+     * Forgets the previous plan, the next solve linearizes around zero actuations.
+     */
+    void Reset() override;
+
+    // The plan from the last solve, in the same layout as the Ipopt variables.
+    VarVector solution_x;
+    double obj_value;
+    int iterations;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+    /**
+     * Runs the nonlinear model from the initial state under u_plan.
+     */
+    void Rollout(const StateVector &state, const CoeffVector &coeffs);
+
+    /**
+     * Fills in the Riccati gains for the Newton step at the current iterate.
+     */
+    void BackwardPass(double sigma_mu);
+
+    /**
+     * Applies the gains from the fixed initial state to get the Newton step.
+     */
+    void ForwardPass();
+
+    const double dt;
+    bool has_plan;
+
+    // Nominal actuations and the trajectory they produce.
+    std::array<UVector, N - 1> u_plan;
+    std::array<ZVector, N> z_nominal;
+
+    // Linearized dynamics around the nominal trajectory.
+    std::array<ZZMatrix, N - 1> A;
+    std::array<ZUMatrix, N - 1> B;
+
+    const AugmentedCost<N> cost;
+
+    // Interior point iterate and step.
+    std::array<ZVector, N> z, dz;
+    std::array<UVector, N - 1> u, du;
+    std::array<CVector, N - 1> slack, dual;
+    std::array<CVector, N - 1> dslack, ddual;
+    CVector h;
+
+    // Riccati feedback and feedforward gains.
+    std::array<UZMatrix, N - 1> K;
+    std::array<UVector, N - 1> k;
+};
+
+extern template class LTVMPC<10>;
+extern template class LTVMPC<15>;
+extern template class LTVMPC<20>;
+extern template class LTVMPC<128>;
+
+#endif /* LTV_MPC_H */
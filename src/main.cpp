@@ -1,22 +1,64 @@
 #include <math.h>
 #include <uWS/uWS.h>
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
-#include "Eigen-3.3/Eigen/QR"
 #include "MPC.h"
-#include "json.hpp"
-
-using json = nlohmann::json;
+#include "delayed_sender.h"
+#include "logger.h"
+#include "polynomial.h"
+#include "solver_pipeline.h"
+#include "steer_message.h"
+#include "telemetry.h"
 
 // CONSTANTs
 static const int WEBSOCKECT_OK_DISCONNECT_CODE = 1000;
 static const string RESET_SIMULATOR_WS_MESSAGE = "42[\"reset\", {}]";
 static const string MANUAL_WS_MESSAGE = "42[\"manual\",{}]";
 
-static const int NUM_WAYPOINTS = 6; // From observed telemetry data
+// The reference line drawn in the simulator: points and their spacing along x.
+static const int NUM_REFERENCE_POINTS = 25;
+static const double REFERENCE_POINT_SPACING = 2.5;
+// Decimals sent for each number of the steer message.
+static const int STEER_MESSAGE_PRECISION = 6;
+
+// Each solve gets a share of the measured telemetry period, in seconds,
+// within bounds. The period starts at the nominal control period and is
+// smoothed exponentially.
+static const double NOMINAL_TELEMETRY_PERIOD = 0.1;
+static const double PERIOD_SMOOTHING = 0.1;
+static const double SOLVE_BUDGET_SHARE = 0.25;
+static const double MIN_SOLVE_BUDGET = 0.01;
+static const double MAX_SOLVE_BUDGET = 0.05;
+
+// Latency
+// The purpose is to mimic real driving conditions where
+// the car does actuate the commands instantly.
+//
+// Feel free to play around with this value but should be to drive
+// around the track with 100ms latency.
+//
+// NOTE: REMEMBER TO SET THIS TO 100 MILLISECONDS BEFORE SUBMITTING.
+static const int ACTUATION_LATENCY_MS = 100;
+
+// The horizon variant driving the simulator, one of those instantiated in MPC.cpp.
+static const size_t HORIZON = 10;
+typedef MPC<HORIZON> Controller;
+// The timestep of the controllers' plans, in seconds.
+static const double PLAN_DT = 0.1;
+// The predicted positions drawn in the simulator, one per actuation.
+static const size_t NUM_MPC_POINTS = HORIZON - 1;
+
+// The waypoints, one coordinate per vector.
+typedef Eigen::Matrix<double, NUM_WAYPOINTS, 1> WaypointVector;
+// One coordinate of the reference line points.
+typedef Eigen::Array<double, NUM_REFERENCE_POINTS, 1> ReferenceArray;
 
 // For converting back and forth between radians and degrees.
 constexpr double pi() { return M_PI; }
@@ -25,70 +67,135 @@ double deg2rad(double x) { return x * pi() / 180; }
 
 double rad2deg(double x) { return x * 180 / pi(); }
 
+// What the event loop keeps about each connected simulator, as the user data
+// of its websocket.
+struct VehicleSession {
+    shared_ptr<SolverPipeline> pipeline;
+    bool justSwitchedToManual;
+    // Smoothed time between telemetry messages, in seconds.
+    double telemetry_period;
+    chrono::steady_clock::time_point last_telemetry;
+};
+
 // More helper funcs, declare them after main loop to maybe clean things up!
-json process_telemetry_data(json reference, MPC mpc);
-string hasData(string s);
-double polyeval(Eigen::VectorXd coeffs, double x);
-Eigen::VectorXd polyfit(Eigen::VectorXd xvals, Eigen::VectorXd yvals, int order);
+string url_parameter(const char *url, size_t length, const string &name);
+bool process_telemetry_data(const Telemetry &telemetry, Controller &mpc,
+                            chrono::steady_clock::time_point deadline, SteerMessageWriter &writer);
 
-void sendMessage(uWS::WebSocket<uWS::SERVER> ws, string msg) {
+void sendMessage(uWS::WebSocket<uWS::SERVER> ws, const string &msg) {
     ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
 }
 
-int main() {
-    uWS::Hub h;
+int main(int argc, char *argv[]) {
+    // The solver backend can be picked on the command line, to compare them
+    // on the same build.
+    // The console output can be cut down with a log level and by sampling
+    // the raw message dumps.
+    string backend = default_solver_backend;
+    LogLevel log_level = LOG_DEBUG;
+    int telemetry_log_every = 1;
+    int latency_ms = ACTUATION_LATENCY_MS;
+    int latency_jitter_ms = 0;
+    int solver_threads = max(thread::hardware_concurrency(), 1u);
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--backend" && i + 1 < argc) {
+            backend = argv[++i];
+        } else if (arg == "--log-level" && i + 1 < argc && ParseLogLevel(argv[i + 1], log_level)) {
+            ++i;
+        } else if (arg == "--log-telemetry-every" && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            telemetry_log_every = atoi(argv[++i]);
+        } else if (arg == "--latency-ms" && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            latency_ms = atoi(argv[++i]);
+        } else if (arg == "--latency-jitter-ms" && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+            latency_jitter_ms = atoi(argv[++i]);
+        } else if (arg == "--solver-threads" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            solver_threads = atoi(argv[++i]);
+        } else {
+            cerr << "Usage: " << argv[0] << " [--backend <name>] [--log-level debug|info|warn|error]"
+                 << " [--log-telemetry-every <n>] [--latency-ms <ms>] [--latency-jitter-ms <ms>]"
+                 << " [--solver-threads <n>]" << endl;
+            return -1;
+        }
+    }
+    if (!IsSolverBackend(backend)) {
+        cerr << "Unknown solver backend " << backend << ", one of:" << endl;
+        PrintSolverBackends(cerr);
+        return -1;
+    }
+    SetLogLevel(log_level);
+    SetTelemetryLogSampling(telemetry_log_every);
 
-    // MPC is initialized here!
-    MPC mpc;
-
-    bool firstTimeConnecting = true;
-    bool justSwitchedToManual = true;
-    h.onMessage([&mpc, &justSwitchedToManual](uWS::WebSocket<uWS::SERVER> ws,
-                                              char *data,
-                                              size_t length,
-                                              uWS::OpCode opCode) {
-        // "42" at the start of the message means there's a websocket message event.
-        // The 4 signifies a websocket message
-        // The 2 signifies a websocket event
-        string sdata = string(data).substr(0, length);
-        cout << sdata << endl;
-        if (sdata.size() > 2 && sdata[0] == '4' && sdata[1] == '2') {
-            string s = hasData(sdata);
-            if (s != "") {
-                auto j = json::parse(s);
-                string event = j[0].get<string>();
-                if (event == "telemetry") {
-                    if (!justSwitchedToManual) {
-                        cout << "Taking back control from manual!!" << endl;
-                        justSwitchedToManual = true;
-                    }
-
-                    json msgJson = process_telemetry_data(j[1], mpc); // j[1] is the data JSON object
-
-                    auto msg = "42[\"steer\"," + msgJson.dump() + "]";
-                    cout << msg << endl;
-
-                    // Latency
-                    // The purpose is to mimic real driving conditions where
-                    // the car does actuate the commands instantly.
-                    //
-                    // Feel free to play around with this value but should be to drive
-                    // around the track with 100ms latency.
-                    //
-                    // NOTE: REMEMBER TO SET THIS TO 100 MILLISECONDS BEFORE SUBMITTING.
-                    this_thread::sleep_for(chrono::milliseconds(100));
-                    sendMessage(ws, msg);
-                } else {
-                    cout << "Received unhandled event: " << event << endl;
-                }
-            } else {
-                if (justSwitchedToManual) {
-                    justSwitchedToManual = false;
-                    cout << "Switched to manual mode!!" << endl;
+    uWS::Hub h;
+    DelayedSender actuation(h.getLoop(), latency_ms, latency_jitter_ms);
+
+    // The solves of all the vehicles share a fixed set of threads, the loop
+    // only parses and sends.
+    SolverPool solvers(
+            h.getLoop(), solver_threads,
+            [&actuation](const SteerFrame &frame) {
+                if (frame.dump_messages) {
+                    Log(LOG_DEBUG, "%.*s", (int) frame.message.length(), frame.message.data());
                 }
+                // Latency, on a timer so the loop keeps running meanwhile.
+                actuation.Send(frame.ws, frame.message.data(), frame.message.length());
+            });
+
+    h.onMessage([](uWS::WebSocket<uWS::SERVER> ws,
+                   char *data,
+                   size_t length,
+                   uWS::OpCode opCode) {
+        const chrono::steady_clock::time_point received = chrono::steady_clock::now();
+        VehicleSession *session = static_cast<VehicleSession *>(ws.getUserData());
+        if (session == NULL) {
+            return;
+        }
+        SolverPipeline &pipeline = *session->pipeline;
+
+        const bool dump_messages = SampleTelemetryLog();
+        if (dump_messages) {
+            Log(LOG_DEBUG, "%.*s", (int) length, data);
+        }
+        // Parsed straight into the solver's next frame, which is only handed
+        // over if it is telemetry.
+        TelemetryFrame &frame = pipeline.NextFrame();
+        const char *event;
+        size_t event_length;
+        const MessageKind kind = ParseMessage(data, length, frame.telemetry, event, event_length);
+        if (kind == MESSAGE_TELEMETRY) {
+            if (!session->justSwitchedToManual) {
+                Log(LOG_INFO, "Taking back control from manual!!");
+                session->justSwitchedToManual = true;
+            }
 
-                sendMessage(ws, MANUAL_WS_MESSAGE);
+            // Budget the solve from how often telemetry actually arrives.
+            if (session->last_telemetry != chrono::steady_clock::time_point()) {
+                const double period = chrono::duration<double>(received - session->last_telemetry).count();
+                session->telemetry_period += PERIOD_SMOOTHING * (period - session->telemetry_period);
+            }
+            session->last_telemetry = received;
+            const double budget = min(max(SOLVE_BUDGET_SHARE * session->telemetry_period, MIN_SOLVE_BUDGET),
+                                      MAX_SOLVE_BUDGET);
+            frame.deadline = received + chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::duration<double>(budget));
+            frame.ws = ws;
+            frame.dump_messages = dump_messages;
+
+            if (!pipeline.Submit()) {
+                Log(LOG_INFO, "Solver busy, dropped a stale telemetry frame (%zu so far)",
+                    pipeline.DroppedFrames());
             }
+        } else if (kind == MESSAGE_MANUAL) {
+            if (session->justSwitchedToManual) {
+                session->justSwitchedToManual = false;
+                Log(LOG_INFO, "Switched to manual mode!!");
+            }
+
+            sendMessage(ws, MANUAL_WS_MESSAGE);
+        } else if (kind == MESSAGE_OTHER_EVENT) {
+            Log(LOG_WARN, "Received unhandled event: %.*s", (int) event_length, event);
+        } else if (kind == MESSAGE_INVALID) {
+            Log(LOG_WARN, "WARN: Ignoring malformed message!");
         }
     });
 
@@ -108,28 +215,66 @@ int main() {
         }
     });
 
-    h.onConnection([&h, &firstTimeConnecting](uWS::WebSocket<uWS::SERVER> ws,
-                                              uWS::HttpRequest req) {
-        if (firstTimeConnecting) {
-            cout << "Connected for first time!!!  Restarting simulator!" << endl;
-            firstTimeConnecting = false;
-            sendMessage(ws, RESET_SIMULATOR_WS_MESSAGE);
-        } else {
-            cout << "Reconnected to simulator, success!" << endl;
+    // Every connection is a vehicle with its own controller, picked with
+    // ws://host:4567/?backend=<name> or the --backend default.
+    h.onConnection([&solvers, &backend](uWS::WebSocket<uWS::SERVER> ws,
+                                        uWS::HttpRequest req) {
+        const uWS::Header url = req.getUrl();
+        string session_backend = url_parameter(url.value, url.valueLength, "backend");
+        if (session_backend.empty()) {
+            session_backend = backend;
+        } else if (!IsSolverBackend(session_backend)) {
+            Log(LOG_WARN, "WARN: Unknown solver backend %s, using %s!", session_backend.c_str(),
+                backend.c_str());
+            session_backend = backend;
         }
+
+        // Owned by the pipeline's functions, so it lives as long as a solve in
+        // progress when the vehicle disconnects. Built and destroyed on the
+        // solver thread, which its CppAD tape belongs to. Its Ipopt solves
+        // use a re-entrant linear solver, so the solver threads do not take
+        // turns on MUMPS.
+        shared_ptr<unique_ptr<Controller> > mpc = make_shared<unique_ptr<Controller> >();
+        VehicleSession *session = new VehicleSession;
+        session->pipeline = solvers.NewPipeline(
+                [mpc, session_backend](const CancelToken &cancel) {
+                    mpc->reset(new Controller(session_backend, PLAN_DT, reentrant_linear_solver));
+                    // Newer telemetry cuts a solve short, see SolverPipeline.
+                    (*mpc)->SetCancelToken(&cancel);
+                },
+                [mpc](const TelemetryFrame &frame, SteerMessageWriter &writer) {
+                    return process_telemetry_data(frame.telemetry, **mpc, frame.deadline, writer);
+                },
+                STEER_MESSAGE_PRECISION,
+                // Real-time iterations prepare the next tick meanwhile.
+                [mpc] { (*mpc)->PrepareNext(); });
+        session->justSwitchedToManual = true;
+        session->telemetry_period = NOMINAL_TELEMETRY_PERIOD;
+        ws.setUserData(session);
+
+        // A new session knows nothing about where the car is, so start over.
+        Log(LOG_INFO, "Vehicle connected with %s!!!  Restarting simulator!", session_backend.c_str());
+        sendMessage(ws, RESET_SIMULATOR_WS_MESSAGE);
     });
 
-    h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws,
-                           int code,
-                           char *message,
-                           size_t length) {
+    h.onDisconnection([&actuation, &solvers](uWS::WebSocket<uWS::SERVER> ws,
+                                             int code,
+                                             char *message,
+                                             size_t length) {
+        actuation.Cancel(ws);
+        VehicleSession *session = static_cast<VehicleSession *>(ws.getUserData());
+        if (session != NULL) {
+            solvers.Remove(session->pipeline);
+            delete session;
+            ws.setUserData(NULL);
+        }
         if (code == WEBSOCKECT_OK_DISCONNECT_CODE) {
-            cout << "Disconnected normally." << endl;
+            Log(LOG_INFO, "Disconnected normally.");
         } else {
-            cout << "Unexpected Disconnect with code: " << code << "!" << endl;
+            Log(LOG_WARN, "Unexpected Disconnect with code: %d!", code);
         }
 
-        cout << "WARN: Not closing WS because we get bad access exception! (Which one cannot catch in C++!?)" << endl;
+        Log(LOG_WARN, "WARN: Not closing WS because we get bad access exception! (Which one cannot catch in C++!?)");
         // StackOverflow https://stackoverflow.com/q/19304157 suggested that error code 1006 means to check onError
         // But, but, but, adding onError here doesn't get called at all, everything seems alright
         // (other than this ws.close() exc_bad_access)
@@ -141,43 +286,42 @@ int main() {
         // Code copied from: https://github.com/uNetworking/uWebSockets/blob/master/tests/main.cpp
         switch ((long) user) {
             case 1:
-                cout << "Client emitted error on invalid URI" << endl;
+                Log(LOG_ERROR, "Client emitted error on invalid URI");
                 break;
             case 2:
-                cout << "Client emitted error on resolve failure" << endl;
+                Log(LOG_ERROR, "Client emitted error on resolve failure");
                 break;
             case 3:
-                cout << "Client emitted error on connection timeout (non-SSL)" << endl;
+                Log(LOG_ERROR, "Client emitted error on connection timeout (non-SSL)");
                 break;
             case 5:
-                cout << "Client emitted error on connection timeout (SSL)" << endl;
+                Log(LOG_ERROR, "Client emitted error on connection timeout (SSL)");
                 break;
             case 6:
-                cout << "Client emitted error on HTTP response without upgrade (non-SSL)" << endl;
+                Log(LOG_ERROR, "Client emitted error on HTTP response without upgrade (non-SSL)");
                 break;
             case 7:
-                cout << "Client emitted error on HTTP response without upgrade (SSL)" << endl;
+                Log(LOG_ERROR, "Client emitted error on HTTP response without upgrade (SSL)");
                 break;
             case 10:
-                cout << "Client emitted error on poll error" << endl;
+                Log(LOG_ERROR, "Client emitted error on poll error");
                 break;
             case 11:
                 static int protocolErrorCount = 0;
                 protocolErrorCount++;
-                cout << "Client emitted error on invalid protocol" << endl;
+                Log(LOG_ERROR, "Client emitted error on invalid protocol");
                 if (protocolErrorCount > 1) {
-                    cout << "FAILURE:  " << protocolErrorCount << " errors emitted for one connection!"
-                              << endl;
+                    Log(LOG_ERROR, "FAILURE:  %d errors emitted for one connection!", protocolErrorCount);
                 }
                 break;
             default:
-                cout << "FAILURE: " << user << " should not emit error!" << endl;
+                Log(LOG_ERROR, "FAILURE: %p should not emit error!", user);
         }
     });
 
     int port = 4567;
     if (h.listen(port)) {
-        cout << "Listening to port " << port << endl;
+        Log(LOG_INFO, "Listening to port %d", port);
     } else {
         cerr << "Failed to listen to port" << endl;
         return -1;
@@ -185,130 +329,77 @@ int main() {
     h.run();
 }
 
-json process_telemetry_data(json jsonData, MPC mpc) {
-    vector<double> ptsx = jsonData["ptsx"];
-    vector<double> ptsy = jsonData["ptsy"];
-    double px = jsonData["x"];
-    double py = jsonData["y"];
-    double psi = jsonData["psi"];
-    double v = jsonData["speed"];
-
-    assert(ptsx.size() == NUM_WAYPOINTS);
-
-    for (int i = 0; i < ptsx.size(); ++i) {
-        // Shift car reference angle to 90 degrees
-        const double shift_x = ptsx[i] - px;
-        const double shift_y = ptsy[i] - py;
-
-        const double rPsi = 0 - psi; // rotated psi
-        ptsx[i] = shift_x * cos(rPsi) - shift_y * sin(rPsi);
-        ptsy[i] = shift_x * sin(rPsi) + shift_y * cos(rPsi);
+// Returns false, with nothing written, if the solve was cancelled.
+bool process_telemetry_data(const Telemetry &telemetry, Controller &mpc,
+                            chrono::steady_clock::time_point deadline, SteerMessageWriter &writer) {
+    const double px = telemetry.x;
+    const double py = telemetry.y;
+    const double psi = telemetry.psi;
+    const double v = telemetry.speed;
+
+    // Shift car reference angle to 90 degrees
+    const double rPsi = 0 - psi; // rotated psi
+    const double cos_rpsi = cos(rPsi);
+    const double sin_rpsi = sin(rPsi);
+    WaypointVector ptsx_transform;
+    WaypointVector ptsy_transform;
+    for (int i = 0; i < NUM_WAYPOINTS; ++i) {
+        const double shift_x = telemetry.ptsx[i] - px;
+        const double shift_y = telemetry.ptsy[i] - py;
+
+        ptsx_transform[i] = shift_x * cos_rpsi - shift_y * sin_rpsi;
+        ptsy_transform[i] = shift_x * sin_rpsi + shift_y * cos_rpsi;
     }
 
+    const CoeffVector coeffs = polyfit(ptsx_transform, ptsy_transform);
 
-    Eigen::Map<Eigen::VectorXd> ptsx_transform(&ptsx[0], NUM_WAYPOINTS);
-    Eigen::Map<Eigen::VectorXd> ptsy_transform(&ptsy[0], NUM_WAYPOINTS);
-
-    auto coeffs = polyfit(ptsx_transform, ptsy_transform, 3);
+    double slope;
+    const double cte = polyeval(coeffs, 0, slope);
+    const double epsi = -atan(slope);
 
-    const double cte = polyeval(coeffs, 0);
-    const double epsi = -atan(coeffs[1]);
-
-    double steer_value = jsonData["steering_angle"];
-    double throttle_value = jsonData["throttle"];
+    double steer_value = telemetry.steering_angle;
+    double throttle_value = telemetry.throttle;
     // ^^ HINT: Could try to estimate above elements due to delay ^^
 
-    Eigen::VectorXd state(NUM_WAYPOINTS);
+    StateVector state;
     state << 0, 0, 0, v, cte, epsi;
 
-    auto vars = mpc.Solve(state, coeffs);
-
-    json msgJson;
-    steer_value = vars[0] / (deg2rad(25) * Lf);
-    throttle_value = vars[1];
-
-    msgJson["steering_angle"] = -1. * steer_value;
-    msgJson["throttle"] = throttle_value;
-
-    //Display the MPC predicted trajectory
-    vector<double> mpc_x_vals;
-    vector<double> mpc_y_vals;
-    for (int i = 2; i < vars.size(); ++i) {
-        if (i % 2 == 0) {
-            mpc_x_vals.push_back(vars[i]);
-        } else {
-            mpc_y_vals.push_back(vars[i]);
-        }
+    const MPCSolution<HORIZON> &solution = mpc.Solve(state, coeffs, deadline);
+    if (solution.stats.status == SOLVE_CANCELLED) {
+        return false;
     }
 
-    //.. add (x,y) points to list here, points are in reference to the vehicle's coordinate system
-    // the points in the simulator are connected by a Green line
-    msgJson["mpc_x"] = mpc_x_vals;
-    msgJson["mpc_y"] = mpc_y_vals;
+    steer_value = solution.steering / (deg2rad(25) * Lf);
+    throttle_value = solution.throttle;
 
     //Display the waypoints/reference line
-    vector<double> next_x_vals;
-    vector<double> next_y_vals;
-    double poly_inc = 2.5;
-    int num_points = 25;
-    for (int i = 0; i < num_points; ++i) {
-        double xToEval = poly_inc * i;
-        next_x_vals.push_back(xToEval);
-        next_y_vals.push_back(polyeval(coeffs, xToEval));
-    }
-
-    msgJson["next_x"] = next_x_vals;
-    msgJson["next_y"] = next_y_vals;
-
-
-    return msgJson;
-}
+    static const ReferenceArray reference_x =
+            ReferenceArray::LinSpaced(0, REFERENCE_POINT_SPACING * (NUM_REFERENCE_POINTS - 1));
+    ReferenceArray reference_y;
+    polyeval(coeffs, reference_x, reference_y);
 
-// Checks if the SocketIO event has JSON data.
-// If there is data the JSON object in string format will be returned,
-// else the empty string "" will be returned.
-string hasData(string s) {
-    auto found_null = s.find("null");
-    auto b1 = s.find_first_of("[");
-    auto b2 = s.rfind("}]");
-    if (found_null != string::npos) {
-        return "";
-    } else if (b1 != string::npos && b2 != string::npos) {
-        return s.substr(b1, b2 - b1 + 2);
-    }
-    return "";
-}
-
-// Evaluate a polynomial.
-double polyeval(Eigen::VectorXd coeffs, double x) {
-    double result = 0.0;
-    for (int i = 0; i < coeffs.size(); i++) {
-        result += coeffs[i] * pow(x, i);
-    }
-    return result;
+    //.. add (x,y) points to list here, points are in reference to the vehicle's coordinate system
+    // the points in the simulator are connected by a Green line. The MPC
+    // predicted trajectory is drawn from after the initial state.
+    writer.Write(-1. * steer_value, throttle_value,
+                 solution.x.data() + 1, solution.y.data() + 1, NUM_MPC_POINTS,
+                 reference_x.data(), reference_y.data(), NUM_REFERENCE_POINTS);
+    return true;
 }
 
-// Fit a polynomial.
-// Adapted from https://github.com/JuliaMath/Polynomials.jl/blob/master/src/Polynomials.jl#L676-L716
-Eigen::VectorXd polyfit(Eigen::VectorXd xvals,
-                        Eigen::VectorXd yvals,
-                        int order) {
-    assert(xvals.size() == yvals.size());
-    assert(order >= 1 && order <= xvals.size() - 1);
-    Eigen::MatrixXd A(xvals.size(), order + 1);
-
-    for (int i = 0; i < xvals.size(); i++) {
-        A(i, 0) = 1.0;
-    }
-
-    for (int j = 0; j < xvals.size(); j++) {
-        for (int i = 0; i < order; i++) {
-            A(j, i + 1) = A(j, i) * xvals(j);
+// Returns the value of a query parameter of a request URL, or "" if it has
+// none.
+string url_parameter(const char *url, size_t length, const string &name) {
+    const string query(url, length);
+    size_t start = query.find('?');
+    while (start != string::npos) {
+        ++start;
+        const size_t end = query.find('&', start);
+        const string parameter = query.substr(start, end == string::npos ? string::npos : end - start);
+        if (parameter.compare(0, name.size() + 1, name + "=") == 0) {
+            return parameter.substr(name.size() + 1);
         }
+        start = end;
     }
-
-    auto Q = A.householderQr();
-    auto result = Q.solve(yvals);
-    return result;
+    return "";
 }
-
@@ -0,0 +1,52 @@
+#ifndef MPC_LAYOUT_H
+#define MPC_LAYOUT_H
+
+#include <cstddef>
+
+// State: x, y, psi, v, cte, epsi.
+constexpr size_t n_state = 6;
+// Actuators: delta, a.
+constexpr size_t n_actuators = 2;
+// The reference line is a cubic polynomial.
+constexpr size_t n_coeffs = 4;
+// The dynamic parameters of the tape: the initial state followed by the
+// fitted polynomial coefficients.
+constexpr size_t n_params = n_state + n_coeffs;
+
+/**
+ * Where each variable block lives in the solver's single vector, for a
+ * horizon of N timesteps.
+ *
+ * The solver takes all the state variables and actuator
+ * variables in a singular vector. Thus, we should to establish
+ * when one variable starts and another ends to make our lives easier.
+ */
+template <size_t N>
+struct MPCLayout {
+    static_assert(N >= 3, "The cost needs at least two actuations to compare");
+
+    static constexpr size_t x_start = 0;
+    static constexpr size_t y_start = x_start + N;
+    static constexpr size_t psi_start = y_start + N;
+    static constexpr size_t v_start = psi_start + N;
+    static constexpr size_t cte_start = v_start + N;
+    static constexpr size_t epsi_start = cte_start + N;
+    static constexpr size_t delta_start = epsi_start + N;
+    static constexpr size_t accel_start = delta_start + N - 1;
+
+    static constexpr size_t n_vars = N * n_state + (N - 1) * n_actuators; // N timesteps == N - 1 actuations
+    static constexpr size_t n_constraints = N * n_state;
+};
+
+template <size_t N> constexpr size_t MPCLayout<N>::x_start;
+template <size_t N> constexpr size_t MPCLayout<N>::y_start;
+template <size_t N> constexpr size_t MPCLayout<N>::psi_start;
+template <size_t N> constexpr size_t MPCLayout<N>::v_start;
+template <size_t N> constexpr size_t MPCLayout<N>::cte_start;
+template <size_t N> constexpr size_t MPCLayout<N>::epsi_start;
+template <size_t N> constexpr size_t MPCLayout<N>::delta_start;
+template <size_t N> constexpr size_t MPCLayout<N>::accel_start;
+template <size_t N> constexpr size_t MPCLayout<N>::n_vars;
+template <size_t N> constexpr size_t MPCLayout<N>::n_constraints;
+
+#endif /* MPC_LAYOUT_H */
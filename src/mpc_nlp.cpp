@@ -0,0 +1,182 @@
+#include "mpc_nlp.h"
+#include <algorithm>
+
+using Ipopt::Index;
+using Ipopt::Number;
+
+template <size_t N> constexpr size_t MPC_NLP<N>::n_vars;
+template <size_t N> constexpr size_t MPC_NLP<N>::n_constraints;
+
+template <size_t N>
+MPC_NLP<N>::~MPC_NLP() {}
+
+template <size_t N>
+void MPC_NLP<N>::ComputeSparsity() {
+    const size_t n_fg = 1 + n_constraints;
+
+    // Jacobian pattern of fg, seeded with the identity.
+    SparsityPattern identity(n_vars);
+    for (size_t j = 0; j < n_vars; ++j) {
+        identity[j].insert(j);
+    }
+    jac_pattern = fg_fun.ForSparseJac(n_vars, identity);
+
+    // Hessian pattern of the sum of all fg components, which covers the
+    // Lagrangian for any objective factor and multipliers.
+    SparsityPattern all_rows(1);
+    for (size_t i = 0; i < n_fg; ++i) {
+        all_rows[0].insert(i);
+    }
+    hes_pattern = fg_fun.RevSparseHes(n_vars, all_rows);
+
+    // The rows come out sorted, so the objective gradient (row 0) entries are
+    // the first n_grad_entries of the Jacobian.
+    for (size_t i = 0; i < n_fg; ++i) {
+        for (std::set<size_t>::const_iterator it = jac_pattern[i].begin();
+             it != jac_pattern[i].end(); ++it) {
+            jac_row.push_back(i);
+            jac_col.push_back(*it);
+        }
+        if (i == 0) {
+            n_grad_entries = jac_row.size();
+        }
+    }
+    jac_values.resize(jac_row.size());
+
+    // Ipopt only wants the lower triangle.
+    for (size_t i = 0; i < n_vars; ++i) {
+        for (std::set<size_t>::const_iterator it = hes_pattern[i].begin();
+             it != hes_pattern[i].end() && *it <= i; ++it) {
+            hes_row.push_back(i);
+            hes_col.push_back(*it);
+        }
+    }
+    hes_values.resize(hes_row.size());
+}
+
+template <size_t N>
+void MPC_NLP<N>::SetParameters(const ParamVector &params) {
+    std::copy(params.begin(), params.end(), params_current.data());
+    fg_fun.new_dynamic(params_current);
+    values_valid = false;
+    jacobian_valid = false;
+}
+
+template <size_t N>
+void MPC_NLP<N>::SetX(const Number *x) {
+    std::copy(x, x + n_vars, x_current.data());
+    values_valid = false;
+    jacobian_valid = false;
+}
+
+template <size_t N>
+void MPC_NLP<N>::UpdateValues() {
+    if (!values_valid) {
+        fg_values = fg_fun.Forward(0, x_current);
+        values_valid = true;
+    }
+}
+
+template <size_t N>
+void MPC_NLP<N>::UpdateJacobian() {
+    if (!jacobian_valid) {
+        fg_fun.SparseJacobianReverse(x_current, jac_pattern, jac_row, jac_col,
+                                     jac_values, jac_work);
+        jacobian_valid = true;
+    }
+}
+
+template <size_t N>
+bool MPC_NLP<N>::get_nlp_info(Index &n, Index &m, Index &nnz_jac_g,
+                           Index &nnz_h_lag, Ipopt::TNLP::IndexStyleEnum &index_style) {
+    n = n_vars;
+    m = n_constraints;
+    nnz_jac_g = jac_row.size() - n_grad_entries;
+    nnz_h_lag = hes_row.size();
+    index_style = Ipopt::TNLP::C_STYLE;
+    return true;
+}
+
+template <size_t N>
+bool MPC_NLP<N>::eval_f(Index n, const Number *x, bool new_x, Number &obj_value) {
+    if (new_x) {
+        SetX(x);
+    }
+    UpdateValues();
+    obj_value = fg_values[0];
+    return true;
+}
+
+template <size_t N>
+bool MPC_NLP<N>::eval_grad_f(Index n, const Number *x, bool new_x, Number *grad_f) {
+    if (new_x) {
+        SetX(x);
+    }
+    UpdateJacobian();
+    std::fill(grad_f, grad_f + n, 0.);
+    for (size_t k = 0; k < n_grad_entries; ++k) {
+        grad_f[jac_col[k]] = jac_values[k];
+    }
+    return true;
+}
+
+template <size_t N>
+bool MPC_NLP<N>::eval_g(Index n, const Number *x, bool new_x, Index m, Number *g) {
+    if (new_x) {
+        SetX(x);
+    }
+    UpdateValues();
+    std::copy(fg_values.data() + 1, fg_values.data() + fg_values.size(), g);
+    return true;
+}
+
+template <size_t N>
+bool MPC_NLP<N>::eval_jac_g(Index n, const Number *x, bool new_x,
+                         Index m, Index nele_jac, Index *iRow,
+                         Index *jCol, Number *values) {
+    if (values == NULL) {
+        for (size_t k = n_grad_entries; k < jac_row.size(); ++k) {
+            iRow[k - n_grad_entries] = jac_row[k] - 1;
+            jCol[k - n_grad_entries] = jac_col[k];
+        }
+        return true;
+    }
+
+    if (new_x) {
+        SetX(x);
+    }
+    UpdateJacobian();
+    std::copy(jac_values.data() + n_grad_entries, jac_values.data() + jac_values.size(),
+              values);
+    return true;
+}
+
+template <size_t N>
+bool MPC_NLP<N>::eval_h(Index n, const Number *x, bool new_x,
+                     Number obj_factor, Index m, const Number *lambda,
+                     bool new_lambda, Index nele_hess, Index *iRow,
+                     Index *jCol, Number *values) {
+    if (values == NULL) {
+        for (size_t k = 0; k < hes_row.size(); ++k) {
+            iRow[k] = hes_row[k];
+            jCol[k] = hes_col[k];
+        }
+        return true;
+    }
+
+    if (new_x) {
+        SetX(x);
+    }
+    hes_weights[0] = obj_factor;
+    std::copy(lambda, lambda + m, hes_weights.data() + 1);
+    fg_fun.SparseHessian(x_current, hes_weights, hes_pattern, hes_row, hes_col,
+                         hes_values, hes_work);
+    std::copy(hes_values.data(), hes_values.data() + hes_values.size(), values);
+    return true;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class MPC_NLP<10>;
+template class MPC_NLP<15>;
+template class MPC_NLP<20>;
+template class MPC_NLP<128>;
@@ -0,0 +1,125 @@
+#ifndef MPC_NLP_H
+#define MPC_NLP_H
+
+#include <set>
+#include <vector>
+#include <cppad/cppad.hpp>
+#include "cppad_threads.h"
+#include "mpc_problem.h"
+
+/**
+ * Ipopt problem backed by a CppAD tape of FG_eval that is recorded only once.
+ *
+ * Everything that changes between telemetry ticks (initial state and fitted
+ * polynomial) enters the tape as dynamic parameters, so a solve only swaps in
+ * new parameter values and runs forward/reverse sweeps over the same optimized
+ * tape, reusing the sparsity patterns computed at construction.
+ *
+ * The tape belongs to the thread that records it: build, solve with and
+ * destroy an MPC_NLP on the same thread, which needs a CppAD thread number
+ * (see ClaimCppADThread) unless it is the master.
+ */
+template <size_t N>
+class MPC_NLP : public MPCProblem<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename MPCProblem<N>::ParamVector ParamVector;
+    typedef CppAD::vector<double> Dvector;
+    typedef std::vector<CppAD::AD<double> > ADvector;
+
+    /**
+     * Records, optimizes and analyses the tape for fg_eval.
+     * @param fg_eval  functor called as fg_eval(fg, vars, params)
+     */
+    template <class FG>
+    explicit MPC_NLP(FG &fg_eval);
+
+    virtual ~MPC_NLP();
+
+    void SetParameters(const ParamVector &params) override;
+
+    bool get_nlp_info(Ipopt::Index &n, Ipopt::Index &m, Ipopt::Index &nnz_jac_g,
+                      Ipopt::Index &nnz_h_lag, Ipopt::TNLP::IndexStyleEnum &index_style) override;
+
+    bool eval_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Number &obj_value) override;
+
+    bool eval_grad_f(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                     Ipopt::Number *grad_f) override;
+
+    bool eval_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Index m, Ipopt::Number *g) override;
+
+    bool eval_jac_g(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                    Ipopt::Index m, Ipopt::Index nele_jac, Ipopt::Index *iRow,
+                    Ipopt::Index *jCol, Ipopt::Number *values) override;
+
+    bool eval_h(Ipopt::Index n, const Ipopt::Number *x, bool new_x,
+                Ipopt::Number obj_factor, Ipopt::Index m, const Ipopt::Number *lambda,
+                bool new_lambda, Ipopt::Index nele_hess, Ipopt::Index *iRow,
+                Ipopt::Index *jCol, Ipopt::Number *values) override;
+
+private:
+    typedef std::vector<std::set<size_t> > SparsityPattern;
+
+    void ComputeSparsity();
+    void SetX(const Ipopt::Number *x);
+    void UpdateValues();
+    void UpdateJacobian();
+
+    static constexpr size_t n_vars = Layout::n_vars;
+    static constexpr size_t n_constraints = Layout::n_constraints;
+
+    CppAD::ADFun<double> fg_fun;
+
+    // Sparsity of the full fg Jacobian (row 0 is the objective gradient) and
+    // the lower triangle of the Lagrangian Hessian.
+    SparsityPattern jac_pattern;
+    SparsityPattern hes_pattern;
+    std::vector<size_t> jac_row, jac_col;
+    std::vector<size_t> hes_row, hes_col;
+    size_t n_grad_entries;
+    CppAD::sparse_jacobian_work jac_work;
+    CppAD::sparse_hessian_work hes_work;
+
+    // Evaluation caches, valid for the current x only. CppAD vectors, so
+    // that the ones the sweeps return come out of CppAD's per-thread memory
+    // pool: once warm, evaluating does not allocate.
+    Dvector params_current;
+    Dvector x_current;
+    Dvector fg_values;
+    Dvector jac_values;
+    Dvector hes_values;
+    Dvector hes_weights;
+    bool values_valid;
+    bool jacobian_valid;
+};
+
+template <size_t N>
+template <class FG>
+MPC_NLP<N>::MPC_NLP(FG &fg_eval)
+        : params_current(n_params),
+          x_current(n_vars), fg_values(1 + n_constraints),
+          hes_weights(1 + n_constraints), values_valid(false), jacobian_valid(false) {
+    SetUpCppADThreads();
+
+    ADvector a_vars(n_vars, 0.);
+    ADvector a_params(n_params, 0.);
+    ADvector a_fg(1 + n_constraints);
+
+    // abort_op_index = 0 and record_compare = false: FG_eval has no branches
+    // on the variables, so the tape stays valid for every x and parameter value.
+    CppAD::Independent(a_vars, 0, false, a_params);
+    fg_eval(a_fg, a_vars, a_params);
+    fg_fun.Dependent(a_vars, a_fg);
+    fg_fun.optimize();
+
+    ComputeSparsity();
+}
+
+extern template class MPC_NLP<10>;
+extern template class MPC_NLP<15>;
+extern template class MPC_NLP<20>;
+extern template class MPC_NLP<128>;
+
+#endif /* MPC_NLP_H */
@@ -0,0 +1,116 @@
+#include "mpc_problem.h"
+#include <algorithm>
+#include <limits>
+#include <coin/IpIpoptCalculatedQuantities.hpp>
+#include <coin/IpIpoptData.hpp>
+#include <coin/IpOrigIpoptNLP.hpp>
+#include <coin/IpTNLPAdapter.hpp>
+
+using Ipopt::Index;
+using Ipopt::Number;
+
+// Constraint violation below which an iterate counts as feasible; Ipopt's
+// default constr_viol_tol.
+static const double feasibility_tolerance = 1e-4;
+
+template <size_t N>
+MPCProblem<N>::MPCProblem()
+        : obj_value(0.), status(Ipopt::UNASSIGNED), deadline_hit(false), cancelled(false),
+          has_feasible_iterate(false), best_obj_value(0.),
+          deadline(std::chrono::steady_clock::time_point::max()), cancel(NULL) {}
+
+template <size_t N>
+MPCProblem<N>::~MPCProblem() {}
+
+template <size_t N>
+bool MPCProblem<N>::get_bounds_info(Index n, Number *x_l, Number *x_u,
+                                    Index m, Number *g_l, Number *g_u) {
+    std::copy(vars_lowerbound.begin(), vars_lowerbound.end(), x_l);
+    std::copy(vars_upperbound.begin(), vars_upperbound.end(), x_u);
+    std::copy(constraints_lowerbound.begin(), constraints_lowerbound.end(), g_l);
+    std::copy(constraints_upperbound.begin(), constraints_upperbound.end(), g_u);
+    return true;
+}
+
+template <size_t N>
+bool MPCProblem<N>::get_starting_point(Index n, bool init_x, Number *x,
+                                       bool init_z, Number *z_L, Number *z_U,
+                                       Index m, bool init_lambda, Number *lambda) {
+    if (init_x) {
+        std::copy(vars.begin(), vars.end(), x);
+    }
+    if (init_z) {
+        std::copy(this->z_L.begin(), this->z_L.end(), z_L);
+        std::copy(this->z_U.begin(), this->z_U.end(), z_U);
+    }
+    if (init_lambda) {
+        std::copy(this->lambda.begin(), this->lambda.end(), lambda);
+    }
+    return true;
+}
+
+template <size_t N>
+void MPCProblem<N>::finalize_solution(Ipopt::SolverReturn status, Index n,
+                                      const Number *x, const Number *z_L,
+                                      const Number *z_U, Index m,
+                                      const Number *g, const Number *lambda,
+                                      Number obj_value, const Ipopt::IpoptData *ip_data,
+                                      Ipopt::IpoptCalculatedQuantities *ip_cq) {
+    std::copy(x, x + n, solution_x.begin());
+    std::copy(z_L, z_L + n, solution_z_L.begin());
+    std::copy(z_U, z_U + n, solution_z_U.begin());
+    std::copy(lambda, lambda + m, solution_lambda.begin());
+    this->obj_value = obj_value;
+    this->status = status;
+}
+
+template <size_t N>
+void MPCProblem<N>::SetDeadline(std::chrono::steady_clock::time_point deadline,
+                                const CancelToken *cancel) {
+    this->deadline = deadline;
+    this->cancel = cancel;
+    deadline_hit = false;
+    cancelled = false;
+    has_feasible_iterate = false;
+    best_obj_value = std::numeric_limits<double>::infinity();
+}
+
+template <size_t N>
+bool MPCProblem<N>::intermediate_callback(Ipopt::AlgorithmMode mode, Index iter,
+                                          Number obj_value, Number inf_pr, Number inf_du,
+                                          Number mu, Number d_norm, Number regularization_size,
+                                          Number alpha_du, Number alpha_pr, Index ls_trials,
+                                          const Ipopt::IpoptData *ip_data,
+                                          Ipopt::IpoptCalculatedQuantities *ip_cq) {
+    // Restoration phase iterates are not iterates of our problem.
+    if (mode == Ipopt::RegularMode && inf_pr <= feasibility_tolerance
+        && obj_value < best_obj_value && ip_cq != NULL) {
+        // Ipopt only hands its internal iterate to the callback; the adapter
+        // maps it back onto our variables.
+        Ipopt::OrigIpoptNLP *orig_nlp =
+                dynamic_cast<Ipopt::OrigIpoptNLP *>(Ipopt::GetRawPtr(ip_cq->GetIpoptNLP()));
+        Ipopt::TNLPAdapter *adapter = orig_nlp == NULL ? NULL :
+                dynamic_cast<Ipopt::TNLPAdapter *>(Ipopt::GetRawPtr(orig_nlp->nlp()));
+        if (adapter != NULL) {
+            adapter->ResortX(*ip_data->curr()->x(), best_x.data());
+            best_obj_value = obj_value;
+            has_feasible_iterate = true;
+        }
+    }
+
+    if (cancel != NULL && cancel->Cancelled()) {
+        cancelled = true;
+        return false;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+        deadline_hit = true;
+        return false;
+    }
+    return true;
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class MPCProblem<10>;
+template class MPCProblem<15>;
+template class MPCProblem<20>;
+template class MPCProblem<128>;
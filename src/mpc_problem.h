@@ -0,0 +1,110 @@
+#ifndef MPC_PROBLEM_H
+#define MPC_PROBLEM_H
+
+#include <array>
+#include <chrono>
+#include <coin/IpTNLP.hpp>
+#include "cancel_token.h"
+#include "mpc_layout.h"
+
+/**
+ * The parts of the Ipopt problem that do not depend on how derivatives are
+ * computed: the starting point, bounds, warm start multipliers and the result
+ * of the last solve.
+ *
+ * Subclasses provide the objective, constraints and their derivatives for the
+ * current dynamic parameters (initial state and fitted polynomial).
+ */
+template <size_t N>
+class MPCProblem : public Ipopt::TNLP {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef std::array<double, Layout::n_vars> VarVector;
+    typedef std::array<double, Layout::n_constraints> ConstraintVector;
+    typedef std::array<double, n_params> ParamVector;
+
+    virtual ~MPCProblem();
+
+    /**
+     * Sets the initial state followed by the fitted polynomial coefficients
+     * used by the next solve.
+     */
+    virtual void SetParameters(const ParamVector &params) = 0;
+
+    /**
+     * Arms the wall-clock deadline for the next solve and forgets the best
+     * iterate of the previous one.
+     * @param cancel  stops the solve at its next iteration once cancelled,
+     *                or NULL
+     */
+    void SetDeadline(std::chrono::steady_clock::time_point deadline,
+                     const CancelToken *cancel = NULL);
+
+    // Starting point and bounds, filled in by the caller before each solve.
+    // The multipliers are only read when Ipopt runs in warm start mode.
+    VarVector vars;
+    VarVector z_L;
+    VarVector z_U;
+    ConstraintVector lambda;
+    VarVector vars_lowerbound;
+    VarVector vars_upperbound;
+    ConstraintVector constraints_lowerbound;
+    ConstraintVector constraints_upperbound;
+
+    // Result of the last solve.
+    VarVector solution_x;
+    VarVector solution_z_L;
+    VarVector solution_z_U;
+    ConstraintVector solution_lambda;
+    double obj_value;
+    Ipopt::SolverReturn status;
+
+    // Whether the last solve was stopped at its deadline, and the lowest cost
+    // feasible iterate it had found by then.
+    bool deadline_hit;
+    // Whether the last solve was stopped by its cancel token.
+    bool cancelled;
+    bool has_feasible_iterate;
+    VarVector best_x;
+    double best_obj_value;
+
+    bool get_bounds_info(Ipopt::Index n, Ipopt::Number *x_l, Ipopt::Number *x_u,
+                         Ipopt::Index m, Ipopt::Number *g_l, Ipopt::Number *g_u) override;
+
+    bool get_starting_point(Ipopt::Index n, bool init_x, Ipopt::Number *x,
+                            bool init_z, Ipopt::Number *z_L, Ipopt::Number *z_U,
+                            Ipopt::Index m, bool init_lambda, Ipopt::Number *lambda) override;
+
+    void finalize_solution(Ipopt::SolverReturn status, Ipopt::Index n,
+                           const Ipopt::Number *x, const Ipopt::Number *z_L,
+                           const Ipopt::Number *z_U, Ipopt::Index m,
+                           const Ipopt::Number *g, const Ipopt::Number *lambda,
+                           Ipopt::Number obj_value, const Ipopt::IpoptData *ip_data,
+                           Ipopt::IpoptCalculatedQuantities *ip_cq) override;
+
+    /**
+     * Keeps the best feasible iterate, and stops Ipopt once the deadline has
+     * passed or the solve is cancelled.
+     */
+    bool intermediate_callback(Ipopt::AlgorithmMode mode, Ipopt::Index iter,
+                               Ipopt::Number obj_value, Ipopt::Number inf_pr,
+                               Ipopt::Number inf_du, Ipopt::Number mu, Ipopt::Number d_norm,
+                               Ipopt::Number regularization_size, Ipopt::Number alpha_du,
+                               Ipopt::Number alpha_pr, Ipopt::Index ls_trials,
+                               const Ipopt::IpoptData *ip_data,
+                               Ipopt::IpoptCalculatedQuantities *ip_cq) override;
+
+protected:
+    MPCProblem();
+
+private:
+    std::chrono::steady_clock::time_point deadline;
+    const CancelToken *cancel;
+};
+
+extern template class MPCProblem<10>;
+extern template class MPCProblem<15>;
+extern template class MPCProblem<20>;
+extern template class MPCProblem<128>;
+
+#endif /* MPC_PROBLEM_H */
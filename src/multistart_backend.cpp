@@ -0,0 +1,139 @@
+#include "multistart_backend.h"
+#include <algorithm>
+#include "backend_registry.h"
+#include "countdown.h"
+#include "kinematic_model.h"
+#include "kinematic_nlp.h"
+#include "logger.h"
+#include "polynomial.h"
+#include "thread_pools.h"
+
+// Speed below which the polynomial start does not steer, in MPH.
+static const double min_steering_speed = 0.1;
+
+static bool is_feasible(SolveStatus status) {
+    return status == SOLVE_CONVERGED || status == SOLVE_DEADLINE_FEASIBLE;
+}
+
+template <size_t N>
+MultiStartBackend<N>::MultiStartBackend(double dt)
+        : dt(dt), winner(START_SHIFTED), cancel(NULL) {
+    for (int i = 0; i < NUM_STARTS; ++i) {
+        // The starts solve at the same time, which MUMPS does not allow.
+        starts[i].reset(new IpoptBackend<N>(new KinematicNLP<N>(dt), reentrant_linear_solver));
+        statuses[i] = SOLVE_FAILED;
+    }
+    zero_start.fill(0.);
+    polynomial_start.fill(0.);
+}
+
+template <size_t N>
+MultiStartBackend<N>::~MultiStartBackend() {}
+
+template <size_t N>
+bool MultiStartBackend<N>::CheckLinearSolver() {
+    return starts[START_SHIFTED]->CheckLinearSolver();
+}
+
+template <size_t N>
+void MultiStartBackend<N>::Reset() {
+    // Only the shifted start carries anything over.
+    starts[START_SHIFTED]->Reset();
+}
+
+template <size_t N>
+void MultiStartBackend<N>::SetCancelToken(const CancelToken *token) {
+    cancel = token;
+    for (int i = 0; i < NUM_STARTS; ++i) {
+        starts[i]->SetCancelToken(token);
+    }
+}
+
+template <size_t N>
+void MultiStartBackend<N>::RolloutAlongPolynomial(const StateVector &state,
+                                                  const CoeffVector &coeffs) {
+    VarVector &vars = polynomial_start;
+    double current[n_state];
+    for (size_t i = 0; i < n_state; ++i) {
+        current[i] = state[i];
+    }
+    for (size_t t = 0; ; ++t) {
+        vars[Layout::x_start + t] = current[0];
+        vars[Layout::y_start + t] = current[1];
+        vars[Layout::psi_start + t] = current[2];
+        vars[Layout::v_start + t] = current[3];
+        vars[Layout::cte_start + t] = current[4];
+        vars[Layout::epsi_start + t] = current[5];
+        if (t + 1 == N) {
+            break;
+        }
+
+        // Turn so that the heading matches the road's after this step.
+        double slope;
+        polyeval(coeffs, current[0], slope);
+        const double heading_error = current[2] - atan(slope);
+        double delta = 0.;
+        if (fabs(current[3]) > min_steering_speed) {
+            delta = -heading_error * Lf / (current[3] * dt);
+            delta = std::min(std::max(delta, -max_delta), max_delta);
+        }
+        vars[Layout::delta_start + t] = delta;
+        vars[Layout::accel_start + t] = 0.;
+
+        double next[n_state];
+        kinematic_step(next, current, delta, 0., coeffs.data(), dt);
+        std::copy(next, next + n_state, current);
+    }
+}
+
+template <size_t N>
+SolveStatus MultiStartBackend<N>::Solve(const StateVector &state, const CoeffVector &coeffs,
+                                        std::chrono::steady_clock::time_point deadline) {
+    RolloutAlongPolynomial(state, coeffs);
+
+    // The other starts go to idle cores while this thread runs the shifted
+    // one, which is the likeliest to win.
+    CountDown running(NUM_STARTS - 1);
+    ComputeWorkers().Schedule([&] {
+        statuses[START_ZERO] = starts[START_ZERO]->SolveFrom(zero_start, state, coeffs, deadline);
+        running.Done();
+    });
+    ComputeWorkers().Schedule([&] {
+        statuses[START_POLYNOMIAL] = starts[START_POLYNOMIAL]->SolveFrom(
+                polynomial_start, state, coeffs, deadline);
+        running.Done();
+    });
+    statuses[START_SHIFTED] = starts[START_SHIFTED]->Solve(state, coeffs, deadline);
+    running.Wait();
+
+    // The best feasible plan, or the shifted start's if none is.
+    winner = START_SHIFTED;
+    for (int i = 0; i < NUM_STARTS; ++i) {
+        if (is_feasible(statuses[i])
+            && (!is_feasible(statuses[winner]) || starts[i]->Cost() < starts[winner]->Cost())) {
+            winner = i;
+        }
+    }
+    if (winner != START_SHIFTED) {
+        Log(LOG_DEBUG, "Start %d won with cost %g", winner, starts[winner]->Cost());
+        starts[START_SHIFTED]->Adopt(*starts[winner]);
+    }
+
+    // Newer telemetry is waiting even if some start finished first, so the
+    // plan is not sent.
+    for (int i = 0; i < NUM_STARTS; ++i) {
+        if (statuses[i] == SOLVE_CANCELLED) {
+            return SOLVE_CANCELLED;
+        }
+    }
+    if (cancel != NULL && cancel->Cancelled()) {
+        return SOLVE_CANCELLED;
+    }
+    return statuses[winner];
+}
+
+// The horizons compiled into the binary, see MPC.cpp.
+template class MultiStartBackend<10>;
+template class MultiStartBackend<15>;
+template class MultiStartBackend<20>;
+template class MultiStartBackend<128>;
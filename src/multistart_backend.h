@@ -0,0 +1,84 @@
+#ifndef MULTISTART_BACKEND_H
+#define MULTISTART_BACKEND_H
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include "ipopt_backend.h"
+#include "solver_backend.h"
+
+/**
+ * Races several differently started Ipopt solves of the same problem, on
+ * otherwise idle cores, and keeps the lowest cost feasible plan.
+ *
+ * On sharp turns a single solve can land in a poor local minimum or fail; the
+ * other starts often do not. The starts are
+ *  - the previous plan, shifted by one timestep and warm started, run on the
+ *    calling thread;
+ *  - all zeros, as a cold solve would;
+ *  - a rollout of the model steering along the fitted polynomial.
+ * All of them stop at the same deadline. Whichever plan wins is the one the
+ * next tick's shifted start continues from.
+ *
+ * Each start has its own Ipopt application and analytic NLP (see
+ * KinematicNLP), so they share no state while they run. They need a
+ * re-entrant linear solver for that, MA27 from HSL, instead of MUMPS.
+ */
+template <size_t N>
+class MultiStartBackend : public SolverBackend<N> {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef typename SolverBackend<N>::VarVector VarVector;
+
+    /**
+     * @param dt  timestep duration, in seconds
+     */
+    explicit MultiStartBackend(double dt);
+
+    virtual ~MultiStartBackend();
+
+    /**
+     * @return whether Ipopt can load the linear solver the starts need, see
+     *         IpoptBackend::CheckLinearSolver
+     */
+    bool CheckLinearSolver();
+
+    SolveStatus Solve(const StateVector &state, const CoeffVector &coeffs,
+                      std::chrono::steady_clock::time_point deadline) override;
+
+    void Reset() override;
+
+    void SetCancelToken(const CancelToken *token) override;
+
+    const VarVector &Solution() const override { return starts[winner]->Solution(); }
+
+    double Cost() const override { return starts[winner]->Cost(); }
+
+    int Iterations() const override { return starts[winner]->Iterations(); }
+
+private:
+    enum Start { START_SHIFTED, START_ZERO, START_POLYNOMIAL, NUM_STARTS };
+
+    /**
+     * Fills polynomial_start with the model rolled out from state, steering
+     * toward the polynomial's heading and keeping the speed.
+     */
+    void RolloutAlongPolynomial(const StateVector &state, const CoeffVector &coeffs);
+
+    double dt;
+    std::array<std::unique_ptr<IpoptBackend<N> >, NUM_STARTS> starts;
+    std::array<SolveStatus, NUM_STARTS> statuses;
+    // The start whose plan the last Solve returned.
+    int winner;
+    const CancelToken *cancel;
+
+    VarVector zero_start;
+    VarVector polynomial_start;
+};
+
+extern template class MultiStartBackend<10>;
+extern template class MultiStartBackend<15>;
+extern template class MultiStartBackend<20>;
+extern template class MultiStartBackend<128>;
+
+#endif /* MULTISTART_BACKEND_H */
@@ -0,0 +1,224 @@
+#ifndef POLYNOMIAL_H
+#define POLYNOMIAL_H
+
+#include <cmath>
+#include <cstddef>
+#include "Eigen-3.3/Eigen/Core"
+#include "mpc_layout.h"
+#include "solver_backend.h"
+
+// Vehicles fitted together by polyfit_batch, one per SIMD lane.
+const int polyfit_batch_lanes = 4;
+
+namespace polynomial_internal {
+
+// Lane-wise helpers, so that FitCubic runs on one fit in doubles or on
+// polyfit_batch_lanes fits at once in Eigen arrays.
+
+inline void SetOne(double &x) { x = 1.; }
+
+template <int L>
+void SetOne(Eigen::Array<double, L, 1> &x) { x.setOnes(); }
+
+// The reflected diagonal entry, -sign(diagonal) * norm with sign(0) = 1, which
+// avoids cancellation when forming the Householder vector.
+inline double ReflectedDiagonal(double diagonal, double norm) {
+    return diagonal < 0 ? norm : -norm;
+}
+
+template <int L>
+Eigen::Array<double, L, 1> ReflectedDiagonal(const Eigen::Array<double, L, 1> &diagonal,
+                                             const Eigen::Array<double, L, 1> &norm) {
+    return (diagonal < 0).select(norm, -norm);
+}
+
+// 1 / x, or 0 for a column that is already zero and needs no reflection.
+inline double InverseOrZero(double x) {
+    return x > 0 ? 1. / x : 0.;
+}
+
+template <int L>
+Eigen::Array<double, L, 1> InverseOrZero(const Eigen::Array<double, L, 1> &x) {
+    return (x > 0).select(x.inverse(), Eigen::Array<double, L, 1>::Zero());
+}
+
+inline double Sqrt(double x) { return std::sqrt(x); }
+
+template <int L>
+Eigen::Array<double, L, 1> Sqrt(const Eigen::Array<double, L, 1> &x) { return x.sqrt(); }
+
+/**
+ * Least squares fit of a cubic to M points by Householder QR of the M x 4
+ * Vandermonde matrix, the same factorization Eigen's householderQr does.
+ *
+ * Every loop has a compile-time trip count, so the compiler unrolls them
+ * completely, and all storage is on the stack.
+ *
+ * @param x, y  the points
+ * @param coeffs  receives the coefficients, lowest order first
+ */
+template <int M, class Scalar>
+void FitCubic(const Scalar (&x)[M], const Scalar (&y)[M], Scalar (&coeffs)[n_coeffs]) {
+    const int n = n_coeffs;
+    static_assert(M >= n, "A cubic needs at least 4 points");
+
+    Scalar a[M][n];
+    Scalar b[M];
+    for (int i = 0; i < M; ++i) {
+        SetOne(a[i][0]);
+        for (int j = 1; j < n; ++j) {
+            a[i][j] = a[i][j - 1] * x[i];
+        }
+        b[i] = y[i];
+    }
+
+    // Reduce A to R column by column, applying each reflection to b. The
+    // Householder vectors overwrite the columns below the diagonal.
+    Scalar r_diagonal[n];
+    for (int k = 0; k < n; ++k) {
+        Scalar norm_squared = a[k][k] * a[k][k];
+        for (int i = k + 1; i < M; ++i) {
+            norm_squared += a[i][k] * a[i][k];
+        }
+        const Scalar alpha = ReflectedDiagonal(a[k][k], Sqrt(norm_squared));
+        // |v|^2 / 2, where v is column k with alpha taken off the diagonal.
+        const Scalar half_v_norm_squared = norm_squared - alpha * a[k][k];
+        const Scalar tau = InverseOrZero(half_v_norm_squared);
+        a[k][k] -= alpha;
+        r_diagonal[k] = alpha;
+
+        for (int j = k + 1; j < n; ++j) {
+            Scalar s = a[k][k] * a[k][j];
+            for (int i = k + 1; i < M; ++i) {
+                s += a[i][k] * a[i][j];
+            }
+            s *= tau;
+            for (int i = k; i < M; ++i) {
+                a[i][j] -= s * a[i][k];
+            }
+        }
+        Scalar s = a[k][k] * b[k];
+        for (int i = k + 1; i < M; ++i) {
+            s += a[i][k] * b[i];
+        }
+        s *= tau;
+        for (int i = k; i < M; ++i) {
+            b[i] -= s * a[i][k];
+        }
+    }
+
+    // Back substitution of R coeffs = Q^T y.
+    for (int k = n - 1; k >= 0; --k) {
+        Scalar sum = b[k];
+        for (int j = k + 1; j < n; ++j) {
+            sum -= a[k][j] * coeffs[j];
+        }
+        coeffs[k] = sum / r_diagonal[k];
+    }
+}
+
+} // namespace polynomial_internal
+
+/**
+ * Fits a cubic to M waypoints.
+ *
+ * Same result as a householderQr solve on the Vandermonde matrix, without
+ * any dynamic allocation.
+ *
+ * @param xvals, yvals  the waypoints
+ * @return the coefficients, lowest order first
+ */
+template <int M>
+CoeffVector polyfit(const Eigen::Matrix<double, M, 1> &xvals,
+                    const Eigen::Matrix<double, M, 1> &yvals) {
+    double x[M];
+    double y[M];
+    for (int i = 0; i < M; ++i) {
+        x[i] = xvals[i];
+        y[i] = yvals[i];
+    }
+    double coeffs[n_coeffs];
+    polynomial_internal::FitCubic<M>(x, y, coeffs);
+    return Eigen::Map<const CoeffVector>(coeffs);
+}
+
+/**
+ * Fits a cubic to each of count sets of M waypoints, such as those of
+ * several vehicles.
+ *
+ * The fits run polyfit_batch_lanes at a time, one per lane of the vector
+ * registers, and give the same coefficients as polyfit.
+ *
+ * @param xvals, yvals  count sets of waypoints
+ * @param coeffs  receives count sets of coefficients
+ */
+template <int M>
+void polyfit_batch(const Eigen::Matrix<double, M, 1> *xvals,
+                   const Eigen::Matrix<double, M, 1> *yvals,
+                   CoeffVector *coeffs, size_t count) {
+    typedef Eigen::Array<double, polyfit_batch_lanes, 1> Lanes;
+
+    for (size_t first = 0; first < count; first += polyfit_batch_lanes) {
+        Lanes x[M];
+        Lanes y[M];
+        for (int l = 0; l < polyfit_batch_lanes; ++l) {
+            // A partial last batch repeats its first fit in the spare lanes.
+            const size_t fit = first + l < count ? first + l : first;
+            for (int i = 0; i < M; ++i) {
+                x[i][l] = xvals[fit][i];
+                y[i][l] = yvals[fit][i];
+            }
+        }
+
+        Lanes lane_coeffs[n_coeffs];
+        polynomial_internal::FitCubic<M>(x, y, lane_coeffs);
+
+        for (int l = 0; l < polyfit_batch_lanes && first + l < count; ++l) {
+            for (size_t k = 0; k < n_coeffs; ++k) {
+                coeffs[first + l][k] = lane_coeffs[k][l];
+            }
+        }
+    }
+}
+
+/**
+ * Evaluates the cubic at x by Horner's scheme.
+ * @param coeffs  the coefficients, lowest order first
+ */
+inline double polyeval(const CoeffVector &coeffs, double x) {
+    return ((coeffs[3] * x + coeffs[2]) * x + coeffs[1]) * x + coeffs[0];
+}
+
+/**
+ * Evaluates the cubic and its derivative at x in the same pass.
+ * @param slope  receives the derivative at x
+ * @return the value at x
+ */
+inline double polyeval(const CoeffVector &coeffs, double x, double &slope) {
+    slope = (3 * coeffs[3] * x + 2 * coeffs[2]) * x + coeffs[1];
+    return polyeval(coeffs, x);
+}
+
+/**
+ * Evaluates the cubic at M points in one pass, which Eigen vectorizes.
+ * @param x  the points
+ * @param y  receives the values at x
+ */
+template <int M>
+void polyeval(const CoeffVector &coeffs, const Eigen::Array<double, M, 1> &x,
+              Eigen::Array<double, M, 1> &y) {
+    y = ((coeffs[3] * x + coeffs[2]) * x + coeffs[1]) * x + coeffs[0];
+}
+
+/**
+ * Evaluates the cubic and its derivative at M points in one pass.
+ * @param slope  receives the derivatives at x
+ */
+template <int M>
+void polyeval(const CoeffVector &coeffs, const Eigen::Array<double, M, 1> &x,
+              Eigen::Array<double, M, 1> &y, Eigen::Array<double, M, 1> &slope) {
+    y = ((coeffs[3] * x + coeffs[2]) * x + coeffs[1]) * x + coeffs[0];
+    slope = (3 * coeffs[3] * x + 2 * coeffs[2]) * x + coeffs[1];
+}
+
+#endif /* POLYNOMIAL_H */
@@ -0,0 +1,108 @@
+#ifndef SOLVER_BACKEND_H
+#define SOLVER_BACKEND_H
+
+#include <array>
+#include <chrono>
+#include "Eigen-3.3/Eigen/Core"
+#include "cancel_token.h"
+#include "mpc_layout.h"
+
+// The initial state: x, y, psi, v, cte, epsi.
+typedef Eigen::Matrix<double, n_state, 1> StateVector;
+// The coefficients of the fitted cubic, lowest order first.
+typedef Eigen::Matrix<double, n_coeffs, 1> CoeffVector;
+
+// Outcome of a solve.
+enum SolveStatus {
+    // The solver converged.
+    SOLVE_CONVERGED,
+    // Stopped at the deadline, with the best feasible plan found by then.
+    SOLVE_DEADLINE_FEASIBLE,
+    // Stopped after a fixed amount of work by design, as a real-time
+    // iteration does, with a feasible plan that has not converged.
+    SOLVE_FEASIBLE,
+    // Stopped at the deadline before finding a feasible plan; the last
+    // iterate is returned.
+    SOLVE_DEADLINE_INFEASIBLE,
+    // Stopped by its cancel token, because a newer problem superseded it;
+    // the last iterate is returned.
+    SOLVE_CANCELLED,
+    // The solver failed for another reason.
+    SOLVE_FAILED
+};
+
+/**
+ * What every backend reports about a solve, measured the same way for all of
+ * them by MPC::Solve.
+ */
+struct SolveStats {
+    SolveStatus status;
+    // Wall-clock time spent in the backend, in seconds.
+    double solve_time;
+    // Solver iterations: Ipopt, interior point or iLQR iterations.
+    int iterations;
+    // Objective value of the returned plan.
+    double cost;
+};
+
+/**
+ * A way of solving the MPC problem over a horizon of N timesteps.
+ *
+ * Backends own all their solver state, so they can keep warm start data from
+ * one tick to the next. See backend_registry.h for the available ones.
+ */
+template <size_t N>
+class SolverBackend {
+public:
+    typedef MPCLayout<N> Layout;
+    typedef std::array<double, Layout::n_vars> VarVector;
+
+    virtual ~SolverBackend() {}
+
+    /**
+     * Solves for a plan from the initial state along the fitted polynomial.
+     * @param state  x, y, psi, v, cte, epsi
+     * @param coeffs  the fitted polynomial
+     * @param deadline  wall-clock time by which the solve returns, with the
+     *                  best plan found so far if it has not converged
+     * @return how the solve ended
+     */
+    virtual SolveStatus Solve(const StateVector &state, const CoeffVector &coeffs,
+                              std::chrono::steady_clock::time_point deadline) = 0;
+
+    /**
+     * Forgets the previous solves, so the next one starts cold.
+     */
+    virtual void Reset() = 0;
+
+    /**
+     * Makes the following solves stop at their next iteration once token is
+     * cancelled. Backends that cannot stop early ignore it.
+     * @param token  outlives the backend, or NULL for none
+     */
+    virtual void SetCancelToken(const CancelToken *token) {}
+
+    /**
+     * Does the part of the next solve that does not need its initial state,
+     * in the idle time before it arrives. Backends that do not split their
+     * solves ignore it.
+     */
+    virtual void PrepareNext() {}
+
+    /**
+     * @return the plan of the last solve, in the MPCLayout<N> variable layout
+     */
+    virtual const VarVector &Solution() const = 0;
+
+    /**
+     * @return the objective value of the last solve's plan
+     */
+    virtual double Cost() const = 0;
+
+    /**
+     * @return the number of iterations of the last solve
+     */
+    virtual int Iterations() const = 0;
+};
+
+#endif /* SOLVER_BACKEND_H */
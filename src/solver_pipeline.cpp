@@ -0,0 +1,125 @@
+#include "solver_pipeline.h"
+#include <algorithm>
+
+static SteerFrame MakeSteerFrame(int precision) {
+    SteerFrame frame = {uWS::WebSocket<uWS::SERVER>(), SteerMessageWriter(precision), false};
+    return frame;
+}
+
+SolverPipeline::SolverPipeline(SolverPool &pool, size_t thread, SolveFunction solve,
+                               int precision, IdleFunction idle)
+        : pool(pool), thread(thread), solve(solve), idle(idle),
+          steer_frames(MakeSteerFrame(precision)), dropped(0), submitted(0), scheduled(false) {}
+
+bool SolverPipeline::Submit() {
+    const uint64_t number = ++submitted;
+    frames.Back().number = number;
+    const bool fresh = frames.Publish();
+    if (!fresh) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Whatever is being solved is stale now. Only after the Publish, so that
+    // the solver has a newer frame to take.
+    cancel.Supersede(number);
+    if (!scheduled.exchange(true)) {
+        std::shared_ptr<SolverPipeline> pipeline = shared_from_this();
+        pool.Schedule(pipeline, [pipeline] { pipeline->Run(); });
+    }
+    return fresh;
+}
+
+void SolverPipeline::Run() {
+    do {
+        while (frames.Take()) {
+            const TelemetryFrame &frame = frames.Front();
+            cancel.Begin(frame.number);
+            SteerFrame &steer_frame = steer_frames.Back();
+            if (!solve(frame, steer_frame.message)) {
+                continue;
+            }
+            steer_frame.ws = frame.ws;
+            steer_frame.dump_messages = frame.dump_messages;
+            steer_frames.Publish();
+            uv_async_send(&pool.steer_ready);
+            // The steer message is on its way; use the wait for the next
+            // frame, unless it is here already.
+            if (idle && !frames.HasNew()) {
+                idle();
+            }
+        }
+        scheduled.store(false);
+        // A frame submitted after the last Take but before the flag was
+        // cleared did not schedule another run, so pick it up here.
+    } while (frames.HasNew() && !scheduled.exchange(true));
+}
+
+void SolverPipeline::Release() {
+    solve = SolveFunction();
+    idle = IdleFunction();
+}
+
+SolverPool::SolverPool(uv_loop_t *loop, int threads, SendFunction send) : send(send) {
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        this->threads.emplace_back(new Eigen::NonBlockingThreadPool(1));
+    }
+    uv_async_init(loop, &steer_ready, &SolverPool::OnSteerFrames);
+    steer_ready.data = this;
+}
+
+SolverPool::~SolverPool() {
+    // The workers wake the loop up through the handle, so they stop first.
+    threads.clear();
+    // libuv lets go of the handle in a callback from the loop, which clears
+    // its data.
+    uv_close(reinterpret_cast<uv_handle_t *>(&steer_ready), &SolverPool::OnClosed);
+    while (steer_ready.data != NULL) {
+        uv_run(steer_ready.loop, UV_RUN_NOWAIT);
+    }
+}
+
+std::shared_ptr<SolverPipeline> SolverPool::NewPipeline(SolverPipeline::SetUpFunction set_up,
+                                                        SolverPipeline::SolveFunction solve,
+                                                        int precision,
+                                                        SolverPipeline::IdleFunction idle) {
+    std::vector<size_t> load(threads.size(), 0);
+    for (size_t i = 0; i < pipelines.size(); ++i) {
+        ++load[pipelines[i]->thread];
+    }
+    const size_t thread = std::min_element(load.begin(), load.end()) - load.begin();
+
+    std::shared_ptr<SolverPipeline> pipeline =
+            std::make_shared<SolverPipeline>(*this, thread, solve, precision, idle);
+    pipelines.push_back(pipeline);
+    // Ahead of any frame, the thread runs its tasks in order.
+    Schedule(pipeline, [pipeline, set_up] { set_up(pipeline->cancel); });
+    return pipeline;
+}
+
+void SolverPool::Remove(const std::shared_ptr<SolverPipeline> &pipeline) {
+    pipeline->cancel.Cancel();
+    pipelines.erase(std::remove(pipelines.begin(), pipelines.end(), pipeline), pipelines.end());
+    // After the solve in progress, if any.
+    Schedule(pipeline, [pipeline] { pipeline->Release(); });
+}
+
+void SolverPool::Schedule(const std::shared_ptr<SolverPipeline> &pipeline,
+                          const std::function<void()> &task) {
+    // The task keeps the pipeline alive while it runs.
+    threads[pipeline->thread]->Schedule(task);
+}
+
+void SolverPool::OnSteerFrames(uv_async_t *handle) {
+    SolverPool *pool = static_cast<SolverPool *>(handle->data);
+    // Async sends coalesce, so look at every vehicle; only the newest message
+    // of each matters anyway.
+    for (size_t i = 0; i < pool->pipelines.size(); ++i) {
+        SolverPipeline &pipeline = *pool->pipelines[i];
+        if (pipeline.steer_frames.Take()) {
+            pool->send(pipeline.steer_frames.Front());
+        }
+    }
+}
+
+void SolverPool::OnClosed(uv_handle_t *handle) {
+    handle->data = NULL;
+}
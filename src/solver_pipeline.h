@@ -0,0 +1,186 @@
+#ifndef SOLVER_PIPELINE_H
+#define SOLVER_PIPELINE_H
+
+#include <uWS/uWS.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "unsupported/Eigen/CXX11/ThreadPool"
+#include "cancel_token.h"
+#include "cppad_threads.h"
+#include "latest_mailbox.h"
+#include "steer_message.h"
+#include "telemetry.h"
+
+// A telemetry frame on its way to the solver.
+struct TelemetryFrame {
+    // Where the steer message goes.
+    uWS::WebSocket<uWS::SERVER> ws;
+    Telemetry telemetry;
+    std::chrono::steady_clock::time_point deadline;
+    // Whether to dump the steer message, see SampleTelemetryLog.
+    bool dump_messages;
+    // Set by Submit, counting up from 1.
+    uint64_t number;
+};
+
+// A steer message on its way back to the event loop.
+struct SteerFrame {
+    uWS::WebSocket<uWS::SERVER> ws;
+    SteerMessageWriter message;
+    bool dump_messages;
+};
+
+class SolverPool;
+
+/**
+ * The solves of one vehicle, run on a SolverPool so the event loop only
+ * parses and sends.
+ *
+ * The loop hands telemetry over through a latest-wins mailbox: the solver
+ * always picks up the newest frame, and frames that arrive while it is busy
+ * replace each other and are counted as dropped. Steer messages come back the
+ * same way. At most one worker runs a pipeline at a time, so the controller
+ * behind the solve function needs no locking.
+ *
+ * A frame submitted while a solve is in progress makes that solve stale, so
+ * the pipeline cancels it through its CancelToken; the solve function is
+ * expected to hand the token to its controller.
+ *
+ * A pipeline stays on one solver thread, which builds, uses and destroys
+ * everything its functions own: a controller's CppAD tape must not change
+ * threads.
+ */
+class SolverPipeline : public std::enable_shared_from_this<SolverPipeline> {
+public:
+    // Solves a frame and formats its steer message, returning false if the
+    // solve was cancelled and there is nothing to send. Runs on a pool thread.
+    typedef std::function<bool(const TelemetryFrame &, SteerMessageWriter &)> SolveFunction;
+    // Gets the next solve ready while no frame is waiting. Runs on a pool
+    // thread.
+    typedef std::function<void()> IdleFunction;
+    // Builds what the other functions use, such as the controller, given the
+    // token that cancels the solves. Runs on a pool thread before the first
+    // solve.
+    typedef std::function<void(const CancelToken &)> SetUpFunction;
+
+    /**
+     * @param thread  index of the pool thread the pipeline runs on
+     * @param precision  see SteerMessageWriter
+     * @param idle  called after a solve when no newer frame is waiting, or
+     *              empty
+     */
+    SolverPipeline(SolverPool &pool, size_t thread, SolveFunction solve, int precision,
+                   IdleFunction idle);
+
+    /**
+     * @return the frame to fill in before Submit. Loop thread only.
+     */
+    TelemetryFrame &NextFrame() { return frames.Back(); }
+
+    /**
+     * Hands the frame filled in NextFrame to the solver, cancelling the solve
+     * in progress if there is one.
+     * @return false if it replaced a frame the solver never got to
+     */
+    bool Submit();
+
+    /**
+     * @return the token cancelled when the frame being solved is superseded
+     */
+    const CancelToken &Cancellation() const { return cancel; }
+
+    /**
+     * @return the number of frames replaced before being solved so far
+     */
+    size_t DroppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class SolverPool;
+
+    // Solves frames until there is no new one, on a pool thread.
+    void Run();
+
+    // Lets go of the functions, and of what they own, on the pool thread.
+    void Release();
+
+    SolverPool &pool;
+    size_t thread;
+    CancelToken cancel;
+    SolveFunction solve;
+    IdleFunction idle;
+    LatestMailbox<TelemetryFrame> frames;
+    LatestMailbox<SteerFrame> steer_frames;
+    std::atomic<size_t> dropped;
+    // The number of the last frame submitted. Loop thread only.
+    uint64_t submitted;
+    // Set while the pipeline is queued or running on the pool.
+    std::atomic<bool> scheduled;
+};
+
+/**
+ * A fixed set of solver threads shared by all the vehicles, and the way back
+ * from them to the event loop. Each new vehicle goes to the thread with the
+ * fewest.
+ */
+class SolverPool {
+public:
+    // Sends a steer message. Runs on the loop thread.
+    typedef std::function<void(const SteerFrame &)> SendFunction;
+
+    /**
+     * @param loop  the event loop the steer messages are sent from
+     * @param threads  number of solver threads
+     */
+    SolverPool(uv_loop_t *loop, int threads, SendFunction send);
+
+    /**
+     * Stops the threads and closes the pool's handle on the loop, running the
+     * loop until libuv is done with it. Loop thread only, while the loop is
+     * not running, such as after it returned.
+     */
+    ~SolverPool();
+
+    /**
+     * Adds a vehicle, whose steer messages are sent until it is removed.
+     * Loop thread only.
+     * @param set_up  run on the vehicle's solver thread before anything else,
+     *                see SolverPipeline
+     */
+    std::shared_ptr<SolverPipeline> NewPipeline(SolverPipeline::SetUpFunction set_up,
+                                                SolverPipeline::SolveFunction solve, int precision,
+                                                SolverPipeline::IdleFunction idle =
+                                                        SolverPipeline::IdleFunction());
+
+    /**
+     * Stops sending the steer messages of a vehicle. A solve in progress is
+     * cancelled, the functions are let go of on their thread once it is
+     * done, and the pipeline goes away with its last reference.
+     */
+    void Remove(const std::shared_ptr<SolverPipeline> &pipeline);
+
+private:
+    friend class SolverPipeline;
+
+    void Schedule(const std::shared_ptr<SolverPipeline> &pipeline,
+                  const std::function<void()> &task);
+    static void OnSteerFrames(uv_async_t *handle);
+    static void OnClosed(uv_handle_t *handle);
+
+    SendFunction send;
+    // The vehicles, for the loop thread.
+    std::vector<std::shared_ptr<SolverPipeline> > pipelines;
+    // Woken up by the workers when there are steer messages to send.
+    uv_async_t steer_ready;
+    // Open for as long as the threads run.
+    CppADParallelSection cppad_section;
+    // A single-threaded pool per solver thread, so that a pipeline can stay
+    // on one. Last, so that the threads stop before anything they use goes
+    // away.
+    std::vector<std::unique_ptr<Eigen::NonBlockingThreadPool> > threads;
+};
+
+#endif /* SOLVER_PIPELINE_H */
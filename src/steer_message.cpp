@@ -0,0 +1,101 @@
+#include "steer_message.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+static const int max_precision = 12;
+
+static const uint64_t powers_of_ten[max_precision + 1] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull
+};
+
+// Longest formatted number, see AppendNumber.
+static const size_t max_number_length = 32;
+
+// Writes the decimal digits of value, at least min_digits of them, backwards
+// from end. Returns where they start.
+static char *WriteDigits(char *end, uint64_t value, int min_digits) {
+    char *p = end;
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+        --min_digits;
+    } while (value != 0 || min_digits > 0);
+    return p;
+}
+
+SteerMessageWriter::SteerMessageWriter(int precision)
+        : precision(std::min(std::max(precision, 0), max_precision)) {
+    buffer.reserve(2048);
+}
+
+void SteerMessageWriter::AppendNumber(double value) {
+    // JSON has no NaN or infinity, they are written as null like json::dump does.
+    if (!std::isfinite(value)) {
+        buffer.append("null", 4);
+        return;
+    }
+
+    const uint64_t scale = powers_of_ten[precision];
+    const double scaled = std::round(std::fabs(value) * scale);
+    char text[max_number_length];
+    if (scaled >= 1e18) {
+        // Beyond the fixed point range; never the case for simulator values.
+        const int length = snprintf(text, sizeof(text), "%.17g", value);
+        buffer.append(text, length);
+        return;
+    }
+
+    uint64_t integer = (uint64_t) scaled / scale;
+    uint64_t fraction = (uint64_t) scaled % scale;
+    char *end = text + sizeof(text);
+    char *begin = end;
+    if (fraction != 0) {
+        int decimals = precision;
+        while (fraction % 10 == 0) {
+            fraction /= 10;
+            --decimals;
+        }
+        begin = WriteDigits(begin, fraction, decimals);
+        *--begin = '.';
+    }
+    begin = WriteDigits(begin, integer, 1);
+    if (value < 0 && scaled != 0) {
+        *--begin = '-';
+    }
+    buffer.append(begin, end - begin);
+}
+
+void SteerMessageWriter::AppendArray(const char *key, const double *values, size_t count) {
+    buffer += '"';
+    buffer += key;
+    buffer.append("\":[", 3);
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            buffer += ',';
+        }
+        AppendNumber(values[i]);
+    }
+    buffer += ']';
+}
+
+void SteerMessageWriter::Write(double steering_angle, double throttle,
+                               const double *mpc_x, const double *mpc_y, size_t n_mpc,
+                               const double *next_x, const double *next_y, size_t n_next) {
+    buffer.clear();
+    buffer.append("42[\"steer\",{");
+    AppendArray("mpc_x", mpc_x, n_mpc);
+    buffer += ',';
+    AppendArray("mpc_y", mpc_y, n_mpc);
+    buffer += ',';
+    AppendArray("next_x", next_x, n_next);
+    buffer += ',';
+    AppendArray("next_y", next_y, n_next);
+    buffer.append(",\"steering_angle\":");
+    AppendNumber(steering_angle);
+    buffer.append(",\"throttle\":");
+    AppendNumber(throttle);
+    buffer.append("}]");
+}
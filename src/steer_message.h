@@ -0,0 +1,44 @@
+#ifndef STEER_MESSAGE_H
+#define STEER_MESSAGE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Formats the 42["steer",{...}] message sent back to the simulator.
+ *
+ * The message is written straight into a buffer that is reused for every
+ * message, so once it has grown to the message size no more allocation
+ * happens. Numbers are printed in fixed point with the given number of
+ * decimals, trailing zeros dropped.
+ */
+class SteerMessageWriter {
+public:
+    /**
+     * @param precision  decimals printed for each number, at most 12
+     */
+    explicit SteerMessageWriter(int precision = 6);
+
+    /**
+     * Formats a message, replacing the previous one.
+     * @param steering_angle, throttle  the actuations, in simulator units
+     * @param mpc_x, mpc_y  the n_mpc predicted points, drawn in green
+     * @param next_x, next_y  the n_next reference line points, drawn in yellow
+     */
+    void Write(double steering_angle, double throttle,
+               const double *mpc_x, const double *mpc_y, size_t n_mpc,
+               const double *next_x, const double *next_y, size_t n_next);
+
+    const char *data() const { return buffer.data(); }
+
+    size_t length() const { return buffer.size(); }
+
+private:
+    void AppendNumber(double value);
+    void AppendArray(const char *key, const double *values, size_t count);
+
+    int precision;
+    std::string buffer;
+};
+
+#endif /* STEER_MESSAGE_H */
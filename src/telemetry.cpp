@@ -0,0 +1,231 @@
+#include "telemetry.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Deepest nesting skipped in fields that are not read.
+const int max_skip_depth = 16;
+// Longest number token, longer ones are malformed.
+const size_t max_number_length = 64;
+
+/**
+ * Reads JSON tokens from a buffer that is not null terminated.
+ */
+class Scanner {
+public:
+    Scanner(const char *begin, const char *end) : p(begin), end(end) {}
+
+    void SkipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            ++p;
+        }
+    }
+
+    // Consumes c after any whitespace, if it is next.
+    bool Consume(char c) {
+        SkipSpace();
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    bool ConsumeLiteral(const char *literal) {
+        SkipSpace();
+        const size_t length = strlen(literal);
+        if ((size_t) (end - p) >= length && memcmp(p, literal, length) == 0) {
+            p += length;
+            return true;
+        }
+        return false;
+    }
+
+    // Reads a string, leaving any escapes in place.
+    bool String(const char *&begin, size_t &length) {
+        if (!Consume('"')) {
+            return false;
+        }
+        begin = p;
+        while (p < end && *p != '"') {
+            p += *p == '\\' ? 2 : 1;
+        }
+        if (p >= end) {
+            return false;
+        }
+        length = p - begin;
+        ++p;
+        return true;
+    }
+
+    bool Number(double &value) {
+        SkipSpace();
+        const char *begin = p;
+        while (p < end && IsNumberChar(*p)) {
+            ++p;
+        }
+        const size_t length = p - begin;
+        if (length == 0 || length >= max_number_length) {
+            return false;
+        }
+        // strtod wants a terminated string, which the buffer is not.
+        char token[max_number_length];
+        memcpy(token, begin, length);
+        token[length] = '\0';
+        char *token_end;
+        value = strtod(token, &token_end);
+        return token_end == token + length;
+    }
+
+    // Reads an array of exactly `count` numbers.
+    bool Numbers(double *values, size_t count) {
+        if (!Consume('[')) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if ((i > 0 && !Consume(',')) || !Number(values[i])) {
+                return false;
+            }
+        }
+        return Consume(']');
+    }
+
+    bool SkipValue(int depth = 0) {
+        if (depth > max_skip_depth) {
+            return false;
+        }
+        SkipSpace();
+        if (p >= end) {
+            return false;
+        }
+        const char *ignored;
+        size_t ignored_length;
+        double ignored_number;
+        switch (*p) {
+            case '"':
+                return String(ignored, ignored_length);
+            case '[':
+            case '{': {
+                const bool object = *p == '{';
+                const char close = object ? '}' : ']';
+                ++p;
+                if (Consume(close)) {
+                    return true;
+                }
+                do {
+                    if (object && (!String(ignored, ignored_length) || !Consume(':'))) {
+                        return false;
+                    }
+                    if (!SkipValue(depth + 1)) {
+                        return false;
+                    }
+                } while (Consume(','));
+                return Consume(close);
+            }
+            case 't':
+                return ConsumeLiteral("true");
+            case 'f':
+                return ConsumeLiteral("false");
+            case 'n':
+                return ConsumeLiteral("null");
+            default:
+                return Number(ignored_number);
+        }
+    }
+
+private:
+    static bool IsNumberChar(char c) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    const char *p;
+    const char *end;
+};
+
+bool Equals(const char *s, size_t length, const char *name) {
+    return length == strlen(name) && memcmp(s, name, length) == 0;
+}
+
+// The fields of a telemetry event, each of which has to be present.
+enum TelemetryField {
+    FIELD_PTSX, FIELD_PTSY, FIELD_X, FIELD_Y, FIELD_PSI, FIELD_PSI_UNITY,
+    FIELD_SPEED, FIELD_STEERING_ANGLE, FIELD_THROTTLE, N_FIELDS
+};
+
+const char *const field_names[N_FIELDS] = {
+    "ptsx", "ptsy", "x", "y", "psi", "psi_unity", "speed", "steering_angle", "throttle"
+};
+
+bool ParseTelemetry(Scanner &scanner, Telemetry &telemetry) {
+    double *const scalars[N_FIELDS] = {
+        NULL, NULL, &telemetry.x, &telemetry.y, &telemetry.psi, &telemetry.psi_unity,
+        &telemetry.speed, &telemetry.steering_angle, &telemetry.throttle
+    };
+
+    if (!scanner.Consume('{')) {
+        return false;
+    }
+    unsigned seen = 0;
+    if (!scanner.Consume('}')) {
+        do {
+            const char *key;
+            size_t key_length;
+            if (!scanner.String(key, key_length) || !scanner.Consume(':')) {
+                return false;
+            }
+            int field = 0;
+            while (field < N_FIELDS && !Equals(key, key_length, field_names[field])) {
+                ++field;
+            }
+
+            bool ok;
+            if (field == FIELD_PTSX) {
+                ok = scanner.Numbers(telemetry.ptsx.data(), NUM_WAYPOINTS);
+            } else if (field == FIELD_PTSY) {
+                ok = scanner.Numbers(telemetry.ptsy.data(), NUM_WAYPOINTS);
+            } else if (field < N_FIELDS) {
+                ok = scanner.Number(*scalars[field]);
+            } else {
+                ok = scanner.SkipValue();
+            }
+            if (!ok) {
+                return false;
+            }
+            if (field < N_FIELDS) {
+                seen |= 1u << field;
+            }
+        } while (scanner.Consume(','));
+        if (!scanner.Consume('}')) {
+            return false;
+        }
+    }
+    return seen == (1u << N_FIELDS) - 1;
+}
+
+} // namespace
+
+MessageKind ParseMessage(const char *data, size_t length, Telemetry &telemetry,
+                         const char *&event, size_t &event_length) {
+    // "42" at the start of the message means there's a websocket message event.
+    // The 4 signifies a websocket message
+    // The 2 signifies a websocket event
+    if (length <= 2 || data[0] != '4' || data[1] != '2') {
+        return MESSAGE_NOT_EVENT;
+    }
+
+    Scanner scanner(data + 2, data + length);
+    if (!scanner.Consume('[') || !scanner.String(event, event_length)) {
+        return MESSAGE_INVALID;
+    }
+    if (!scanner.Consume(',') || scanner.ConsumeLiteral("null")) {
+        return MESSAGE_MANUAL;
+    }
+    if (!Equals(event, event_length, "telemetry")) {
+        return MESSAGE_OTHER_EVENT;
+    }
+    if (!ParseTelemetry(scanner, telemetry) || !scanner.Consume(']')) {
+        return MESSAGE_INVALID;
+    }
+    return MESSAGE_TELEMETRY;
+}
@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <array>
+#include <cstddef>
+
+static const int NUM_WAYPOINTS = 6; // From observed telemetry data
+
+/**
+ * The fields of a telemetry event, as sent by the simulator.
+ */
+struct Telemetry {
+    // The waypoints, in map coordinates.
+    std::array<double, NUM_WAYPOINTS> ptsx;
+    std::array<double, NUM_WAYPOINTS> ptsy;
+    // The car's position and heading in map coordinates, in radians, and the
+    // heading as the simulator displays it.
+    double x;
+    double y;
+    double psi;
+    double psi_unity;
+    // In MPH.
+    double speed;
+    // The current actuations.
+    double steering_angle;
+    double throttle;
+};
+
+// What a websocket message turned out to be.
+enum MessageKind {
+    // Not a socket.io event, ignored.
+    MESSAGE_NOT_EVENT,
+    // A telemetry event.
+    MESSAGE_TELEMETRY,
+    // An event without data, which the simulator sends in manual mode.
+    MESSAGE_MANUAL,
+    // An event other than telemetry.
+    MESSAGE_OTHER_EVENT,
+    // A malformed event, or telemetry without all the expected fields.
+    MESSAGE_INVALID
+};
+
+/**
+ * Parses a socket.io message of the form 42["telemetry",{...}] in a single
+ * pass over the websocket buffer.
+ *
+ * Reads only the first `length` bytes of data, never copies it and builds no
+ * DOM: the numbers go straight into `telemetry` and any other field is
+ * skipped.
+ *
+ * @param telemetry  receives the fields of a MESSAGE_TELEMETRY
+ * @param event, event_length  receive the event name of an event, pointing
+ *                             into data
+ * @return what the message is
+ */
+MessageKind ParseMessage(const char *data, size_t length, Telemetry &telemetry,
+                         const char *&event, size_t &event_length);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,48 @@
+#include "thread_pools.h"
+#include <algorithm>
+#include <thread>
+#include "countdown.h"
+
+Eigen::NonBlockingThreadPool &ComputeWorkers() {
+    static Eigen::NonBlockingThreadPool workers(std::max(std::thread::hardware_concurrency(), 1u));
+    return workers;
+}
+
+void OnEveryThread(Eigen::NonBlockingThreadPool &pool, const std::function<void(int thread)> &task) {
+    // Each call holds on to its thread until all of them have started, so
+    // that no two land on the same thread.
+    const int threads = pool.NumThreads();
+    CountDown started(threads);
+    CountDown finished(threads);
+    for (int i = 0; i < threads; ++i) {
+        pool.Schedule([&pool, &task, &started, &finished] {
+            started.Done();
+            started.Wait();
+            task(pool.CurrentThreadId());
+            finished.Done();
+        });
+    }
+    finished.Wait();
+}
+
+void ParallelFor(size_t count, size_t chunks,
+                 const std::function<void(size_t chunk, size_t begin, size_t end)> &body) {
+    Eigen::NonBlockingThreadPool &workers = ComputeWorkers();
+    if (chunks <= 1 || workers.CurrentThreadId() >= 0) {
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            body(chunk, chunk * count / chunks, (chunk + 1) * count / chunks);
+        }
+        return;
+    }
+
+    // The calling thread takes the first chunk itself.
+    CountDown running(chunks - 1);
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.Schedule([&body, &running, count, chunks, chunk] {
+            body(chunk, chunk * count / chunks, (chunk + 1) * count / chunks);
+            running.Done();
+        });
+    }
+    body(0, 0, count / chunks);
+    running.Wait();
+}
@@ -0,0 +1,34 @@
+#ifndef THREAD_POOLS_H
+#define THREAD_POOLS_H
+
+#include <cstddef>
+#include <functional>
+#include "unsupported/Eigen/CXX11/ThreadPool"
+
+/**
+ * @return the threads shared by all the solvers for work within one solve,
+ *         one per core. Separate from the threads solves run on, which wait
+ *         for them.
+ */
+Eigen::NonBlockingThreadPool &ComputeWorkers();
+
+/**
+ * Calls task(thread) once on every thread of pool, with the thread's id in
+ * the pool, and returns once all calls are done. For setting up and tearing
+ * down what each thread keeps to itself. Not to be called from pool itself.
+ */
+void OnEveryThread(Eigen::NonBlockingThreadPool &pool, const std::function<void(int thread)> &task);
+
+/**
+ * Splits [0, count) into chunks consecutive ranges and calls
+ * body(chunk, begin, end) for each, on the compute workers and the calling
+ * thread, returning once all are done.
+ *
+ * The ranges only depend on count and chunks, so per-chunk results can be
+ * combined in a fixed order. Called from a compute worker, every chunk runs on
+ * the calling thread instead, so nested calls cannot tie up the pool.
+ */
+void ParallelFor(size_t count, size_t chunks,
+                 const std::function<void(size_t chunk, size_t begin, size_t end)> &body);
+
+#endif /* THREAD_POOLS_H */